@@ -0,0 +1,224 @@
+#include <qpl/qpl.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "../src/widgets.hpp"
+#include "../src/session_store.hpp"
+
+//headless benchmarks for the widget board, script interpretation and session io.
+//usage: benchmark [output.json] [max widget count]
+//results are written as json, one entry per measured operation and board size
+//
+//building: this file is its own executable with its own main, it must not be compiled into the app.
+//compile it alone with the same c++20 settings, include paths (qpl, sfml) and libraries as src/main.cpp, e.g.
+//	g++ -std=c++20 -O2 benchmark/benchmark.cpp -o widgets_benchmark -lqpl -lsfml-graphics -lsfml-window -lsfml-system
+//or add a console project that only contains benchmark/benchmark.cpp to the solution.
+//run it from the repository root, the fonts are loaded from resources/
+
+struct benchmark_result {
+	std::string name;
+	qpl::size widget_count = 0u;
+	qpl::size iterations = 0u;
+	qpl::f64 total_ms = 0.0;
+	qpl::f64 min_ms = 0.0;
+	qpl::f64 max_ms = 0.0;
+
+	std::string json() const {
+		return qpl::to_string(
+			"{\"name\": \"", this->name, "\", \"widgets\": ", this->widget_count, ", \"iterations\": ", this->iterations,
+			", \"total_ms\": ", this->total_ms, ", \"mean_ms\": ", this->iterations ? this->total_ms / this->iterations : 0.0,
+			", \"min_ms\": ", this->min_ms, ", \"max_ms\": ", this->max_ms, "}"
+		);
+	}
+};
+
+struct benchmark {
+	std::vector<benchmark_result> results;
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "widgets_benchmark";
+	std::mt19937_64 random{ 1234u };
+
+	template<typename F>
+	void measure(const std::string& name, qpl::size widget_count, qpl::size iterations, F&& function) {
+		benchmark_result result;
+		result.name = name;
+		result.widget_count = widget_count;
+		result.iterations = iterations;
+		result.min_ms = std::numeric_limits<qpl::f64>::max();
+		for (qpl::size i = 0u; i < iterations; ++i) {
+			auto start = profiler::now();
+			function(i);
+			auto ms = (profiler::now() - start) / 1e6;
+			result.total_ms += ms;
+			result.min_ms = std::min(result.min_ms, ms);
+			result.max_ms = std::max(result.max_ms, ms);
+		}
+		qpl::println(qpl::str_lspaced(name, 24), qpl::str_rspaced(widget_count, 8), " widgets ", qpl::str_rspaced(qpl::to_string_precision(3, result.total_ms / std::max(iterations, qpl::size{ 1u })), 10), " ms");
+		this->results.push_back(std::move(result));
+	}
+
+	//widgets are laid out on a plain grid so building the board doesn't depend on find_free_spot_for
+	void build_board(widgets& widgets, qpl::size count) {
+		widgets.load_default();
+		auto columns = static_cast<qpl::size>(std::sqrt(static_cast<qpl::f64>(count))) + 1;
+		for (qpl::size i = 0u; i < count; ++i) {
+			widget widget;
+			widget.init();
+			if (i % 4u == 3u) {
+				widget.set_widget_type(widget_type::executable_script);
+				widget.set_text(qpl::string_to_wstring(qpl::to_string("$root = ", i, "\ncopy $root$/a $root$/b\nsync $root$/a $root$/c fast")));
+			}
+			else {
+				widget.set_text(qpl::string_to_wstring(qpl::to_string("widget ", i, "\nsome text on a second line")));
+			}
+			widget.update_background();
+			widget.set_position(qpl::vec(i % columns, i / columns) * 800.f);
+			widgets.add(std::move(widget));
+		}
+	}
+
+	void run_board(qpl::size count) {
+		widgets widgets;
+		this->measure("build", count, 1u, [&](qpl::size) {
+			this->build_board(widgets, count);
+		});
+
+		qpl::vec2 low = widgets.get_bounds(0u).position;
+		qpl::vec2 high = low;
+		for (qpl::size i = 1u; i < widgets.widgets.size(); ++i) {
+			auto bounds = widgets.get_bounds(i);
+			low.x = std::min(low.x, bounds.position.x);
+			low.y = std::min(low.y, bounds.position.y);
+			high.x = std::max(high.x, bounds.position.x + bounds.dimension.x);
+			high.y = std::max(high.y, bounds.position.y + bounds.dimension.y);
+		}
+		std::uniform_real_distribution<qpl::f32> x(low.x, high.x);
+		std::uniform_real_distribution<qpl::f32> y(low.y, high.y);
+
+		this->measure("find_free_spot_for", count, 100u, [&](qpl::size) {
+			auto hitbox = widgets.widgets[0].get_hitbox();
+			hitbox.set_center(qpl::vec(x(this->random), y(this->random)));
+			widgets.find_free_spot_for(hitbox);
+		});
+
+		widgets.copied = widgets.handles.get_handle(0u);
+		this->measure("paste", count, 100u, [&](qpl::size) {
+			widgets.paste(qpl::vec(x(this->random), y(this->random)));
+		});
+
+		this->measure("delete", count, 100u, [&](qpl::size) {
+			std::uniform_int_distribution<qpl::size> index(0u, widgets.widgets.size() - 1);
+			widgets.remove(index(this->random));
+		});
+
+		//without input only the pending widgets are updated, the way an idle frame runs. main_state::save and
+		//main_state::load aren't part of it, saving and loading are measured on their own below
+		qsf::event_info event;
+		this->measure("widgets::update idle frame, no save/load", count, 100u, [&](qpl::size) {
+			widgets.update(event);
+		});
+
+		session_store session;
+		session.snapshot_path = (this->directory / "session.dat").string();
+		session.journal_path = (this->directory / "session.journal").string();
+		std::filesystem::remove(session.snapshot_path);
+		std::filesystem::remove(session.journal_path);
+		qsf::view_control view;
+
+		this->measure("save full", count, 5u, [&](qpl::size) {
+			session.compaction_due = true;
+			session.save(widgets, view);
+		});
+		this->measure("save journal", count, 5u, [&](qpl::size i) {
+			widgets.widgets[i % widgets.widgets.size()].move(qpl::vec(1, 1));
+			session.save(widgets, view);
+		});
+		this->measure("load", count, 5u, [&](qpl::size) {
+			::widgets loaded;
+			qsf::view_control loaded_view;
+			if (!session.load(loaded, loaded_view)) {
+				qpl::println("benchmark: couldn't load session");
+			}
+		});
+	}
+
+	//a source tree of small files that the scripts copy and sync around
+	void create_tree(const std::filesystem::path& root, qpl::size directories, qpl::size files, qpl::size file_size) {
+		std::string content(file_size, 'x');
+		for (qpl::size d = 0u; d < directories; ++d) {
+			auto directory = root / qpl::to_string("directory", d);
+			std::filesystem::create_directories(directory);
+			for (qpl::size f = 0u; f < files; ++f) {
+				std::ofstream file(directory / qpl::to_string("file", f, ".txt"), std::ios::binary);
+				file.write(content.data(), content.size());
+			}
+		}
+	}
+
+	void run_scripts() {
+		auto root = this->directory / "scripts";
+		std::filesystem::remove_all(root);
+		this->create_tree(root / "source", 20u, 50u, 4096u);
+		auto files = qpl::size{ 20u * 50u };
+
+		auto root_string = root.generic_string();
+		text_rope text;
+		text.assign(qpl::string_to_wstring(qpl::to_string(
+			"$root = ", root_string, "\n",
+			"copy $root$/source $root$/copy\n",
+			"sync $root$/source $root$/synced\n",
+			"sync $root$/source $root$/synced hash\n",
+			"remove $root$/copy\n"
+		)));
+
+		std::shared_ptr<const compiled_script> script;
+		this->measure("script compile", files, 1000u, [&](qpl::size) {
+			script = compile_script(text);
+		});
+		this->measure("script execute", files, 3u, [&](qpl::size) {
+			script_job job;
+			job.script = script;
+			execute_script(job);
+			if (job.error_count) {
+				qpl::println("benchmark: script failed: ", job.get_error());
+			}
+		});
+		std::filesystem::remove_all(root);
+	}
+
+	std::string json() const {
+		std::string result = "{\n\t\"results\": [\n";
+		for (qpl::size i = 0u; i < this->results.size(); ++i) {
+			result += qpl::to_string("\t\t", this->results[i].json(), i + 1 == this->results.size() ? "\n" : ",\n");
+		}
+		result += "\t]\n}\n";
+		return result;
+	}
+};
+
+int main(int argc, char** argv) try {
+	qsf::add_font("helvetica", "resources/Helvetica.ttf");
+	qsf::add_font("consola", "resources/consola.ttf");
+
+	std::string output = argc > 1 ? argv[1] : "benchmark.json";
+	qpl::size max_count = argc > 2 ? std::stoull(argv[2]) : 100'000u;
+
+	benchmark benchmark;
+	std::filesystem::create_directories(benchmark.directory);
+	for (qpl::size count = 1'000u; count <= max_count; count *= 10u) {
+		benchmark.run_board(count);
+	}
+	benchmark.run_scripts();
+	std::filesystem::remove_all(benchmark.directory);
+
+	std::ofstream file(output);
+	file << benchmark.json();
+	if (!file) {
+		qpl::println("couldn't write ", output);
+		return 1;
+	}
+	qpl::println("wrote ", output);
+}
+catch (std::exception& any) {
+	qpl::println("caught exception:\n", any.what());
+	return 1;
+}
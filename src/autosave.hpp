@@ -0,0 +1,91 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include "session_store.hpp"
+#include "config.hpp"
+
+//writes captured session snapshots on a background thread, the ui thread only pays for the capture.
+//snapshots are written in submission order since each one only holds the changes since the previous
+struct autosave {
+	session_store& store;
+	std::thread worker;
+	std::deque<session_snapshot> queue;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::condition_variable idle_condition;
+	bool writing = false;
+	bool stopping = false;
+	qpl::f64 elapsed = 0.0;
+
+	autosave(session_store& store) : store(store) {
+		this->worker = std::thread([this]() {
+			this->work();
+		});
+	}
+	~autosave() {
+		{
+			std::lock_guard lock(this->mutex);
+			this->stopping = true;
+		}
+		this->condition.notify_all();
+		this->worker.join();
+	}
+	autosave(const autosave&) = delete;
+	autosave& operator=(const autosave&) = delete;
+
+	void submit(widgets& widgets, const qsf::view_control& view) {
+		auto snapshot = this->store.capture(widgets, view);
+		{
+			std::lock_guard lock(this->mutex);
+			this->queue.push_back(std::move(snapshot));
+		}
+		this->condition.notify_one();
+		this->elapsed = 0.0;
+	}
+	bool is_busy() {
+		std::lock_guard lock(this->mutex);
+		return this->writing || !this->queue.empty();
+	}
+	//blocks until every submitted snapshot is on disk, needed before the store is used from the ui thread
+	void wait() {
+		std::unique_lock lock(this->mutex);
+		this->idle_condition.wait(lock, [&]() {
+			return !this->writing && this->queue.empty();
+		});
+	}
+
+	//called every frame, only submits when the previous autosave has finished
+	void update(qpl::f64 frame_time, widgets& widgets, const qsf::view_control& view) {
+		this->elapsed += frame_time;
+		if (this->elapsed >= config::autosave_interval && !this->is_busy()) {
+			this->submit(widgets, view);
+		}
+	}
+
+private:
+	void work() {
+		while (true) {
+			session_snapshot snapshot;
+			{
+				std::unique_lock lock(this->mutex);
+				this->condition.wait(lock, [&]() {
+					return this->stopping || !this->queue.empty();
+				});
+				if (this->queue.empty()) {
+					return;
+				}
+				snapshot = std::move(this->queue.front());
+				this->queue.pop_front();
+				this->writing = true;
+			}
+			this->store.write(snapshot);
+			{
+				std::lock_guard lock(this->mutex);
+				this->writing = false;
+			}
+			this->idle_condition.notify_all();
+		}
+	}
+};
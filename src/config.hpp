@@ -4,4 +4,43 @@
 namespace config {
 	constexpr qpl::f32 widget_slope_dimension = 35.f;
 	constexpr qpl::f32 widget_background_slope_dimension = 60.f;
+	constexpr qpl::f32 widget_grid_cell_size = 512.f;
+	constexpr qpl::f32 widget_text_character_size = 40.f;
+	constexpr qpl::f32 widget_lod_text_pixel_size = 6.f;
+	constexpr qpl::size widget_stream_per_frame = 16u;
+	constexpr qpl::size widget_decode_ahead = 256u;
+	constexpr auto widget_text_color = qpl::rgb::white();
+	constexpr auto widget_text_background_color = qpl::rgb::grey_shade(30);
+	constexpr qpl::size text_run_cache_purge_interval = 1024u;
+	constexpr qpl::f32 widget_cull_margin = 200.f;
+	constexpr qpl::size widget_batch_corner_segments = 6u;
+	constexpr qpl::f32 widget_texture_margin = 8.f;
+	constexpr qpl::f32 widget_texture_zoom_steps = 2.f;
+	constexpr qpl::u32 widget_texture_max_size = 2048u;
+	constexpr qpl::size widget_texture_memory_limit = 128u * 1024u * 1024u;
+	constexpr qpl::size widget_texture_renders_per_frame = 16u;
+	constexpr qpl::size script_worker_count = 4u;
+	constexpr qpl::f64 script_watch_debounce = 0.5;
+	constexpr qpl::f64 file_watch_poll_interval = 1.0;
+	constexpr qpl::size copy_thread_count = 8u;
+	constexpr qpl::u64 copy_chunk_size = 64ull * 1024ull * 1024ull;
+	constexpr auto sync_manifest_directory = "data/sync";
+	constexpr auto session_snapshot_path = "data/session.dat";
+	constexpr auto session_journal_path = "data/session.journal";
+	constexpr qpl::size session_block_size = 64u * 1024u;
+	constexpr qpl::size session_journal_max_records = 4096u;
+	constexpr qpl::u64 session_journal_min_bytes = 64ull * 1024ull;
+	constexpr qpl::size search_index_per_frame = 1024u;
+	constexpr qpl::size search_max_results = 12u;
+	constexpr qpl::size search_snippet_length = 60u;
+	constexpr qpl::size search_counted_occurrences = 4u;
+	constexpr qpl::size search_max_candidates = 8192u;
+	constexpr qpl::f32 search_jump_fill = 0.6f;
+	constexpr qpl::size undo_memory_limit = 4u * 1024u * 1024u;
+	constexpr qpl::f64 undo_coalesce_time = 1.0;
+	constexpr qpl::f64 autosave_interval = 30.0;
+	constexpr bool autosave_on_close = true;
+	constexpr qpl::size profiler_history = 240u;
+	constexpr qpl::size profiler_refresh_frames = 15u;
+	constexpr auto profiler_csv_path = "data/profile.csv";
 }
\ No newline at end of file
@@ -0,0 +1,345 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include "config.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#endif
+
+struct copy_statistics {
+	std::atomic<qpl::u64> bytes = 0u;
+	std::atomic<qpl::u64> files = 0u;
+	std::atomic<qpl::u64> total_bytes = 0u;
+	std::atomic<qpl::u64> total_files = 0u;
+	std::atomic<qpl::i64> start_ticks = 0;
+
+	void start() {
+		this->start_ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+	qpl::f64 elapsed_seconds() const {
+		auto start = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(this->start_ticks.load()));
+		return std::chrono::duration<qpl::f64>(std::chrono::steady_clock::now() - start).count();
+	}
+	qpl::f64 bytes_per_second() const {
+		auto elapsed = this->elapsed_seconds();
+		return elapsed > 0.0 ? this->bytes.load() / elapsed : 0.0;
+	}
+	qpl::f64 files_per_second() const {
+		auto elapsed = this->elapsed_seconds();
+		return elapsed > 0.0 ? this->files.load() / elapsed : 0.0;
+	}
+	std::string string() const {
+		return qpl::to_string(this->files.load(), " / ", this->total_files.load(), " files, ",
+			this->bytes.load() / (1024.0 * 1024.0), " MB at ",
+			this->bytes_per_second() / (1024.0 * 1024.0), " MB/s, ",
+			this->files_per_second(), " files/s");
+	}
+};
+
+//copies files and directory trees across a pool of worker threads.
+//large files are split into chunks that are copied in parallel, on linux with copy_file_range / sendfile.
+struct copy_engine {
+	struct file_task {
+		std::filesystem::path source;
+		std::filesystem::path destination;
+		qpl::u64 size = 0u;
+		std::filesystem::file_time_type write_time;
+		//chunked copies get the source permissions once the last chunk is written, a read-only mode
+		//set earlier would keep the other chunks from opening the destination
+		std::filesystem::perms permissions = std::filesystem::perms::unknown;
+		std::atomic<qpl::size> remaining_chunks = 0u;
+	};
+	struct chunk_task {
+		file_task* file = nullptr;
+		qpl::u64 offset = 0u;
+		qpl::u64 size = 0u;
+		bool whole_file = true;
+	};
+
+	copy_statistics* statistics = nullptr;
+	const std::atomic_bool* cancel = nullptr;
+	qpl::size thread_count = config::copy_thread_count;
+	qpl::u64 chunk_size = config::copy_chunk_size;
+
+	std::vector<std::string> errors;
+
+	copy_engine() = default;
+	copy_engine(copy_statistics* statistics, const std::atomic_bool* cancel = nullptr) {
+		this->statistics = statistics;
+		this->cancel = cancel;
+	}
+
+	bool is_cancelled() const {
+		return this->cancel && this->cancel->load();
+	}
+
+	//source directory: its contents are copied onto destination, overwriting existing files.
+	//source file: copied to destination, or into it if destination is an existing directory.
+	bool copy(const std::filesystem::path& source, const std::filesystem::path& destination) {
+		std::vector<std::unique_ptr<file_task>> files;
+		std::error_code error;
+
+		if (std::filesystem::is_directory(source, error)) {
+			std::filesystem::create_directories(destination, error);
+			for (auto it = std::filesystem::recursive_directory_iterator(source, error); it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+				if (error) {
+					this->add_error(qpl::to_string("copy: ", error.message()));
+					break;
+				}
+				auto target = destination / std::filesystem::relative(it->path(), source, error);
+				if (it->is_directory(error)) {
+					std::filesystem::create_directories(target, error);
+				}
+				else if (it->is_regular_file(error)) {
+					this->add_file(files, it->path(), target);
+				}
+			}
+		}
+		else if (std::filesystem::is_regular_file(source, error)) {
+			auto target = destination;
+			if (std::filesystem::is_directory(destination, error)) {
+				target /= source.filename();
+			}
+			else if (target.has_parent_path()) {
+				std::filesystem::create_directories(target.parent_path(), error);
+			}
+			this->add_file(files, source, target);
+		}
+		else {
+			this->add_error(qpl::to_string("copy: \"", source.string(), "\" doesn't exist."));
+			return false;
+		}
+		return this->copy_files(files);
+	}
+
+	//renames when possible, otherwise copies and removes the source
+	bool move(const std::filesystem::path& source, const std::filesystem::path& destination) {
+		std::error_code error;
+		auto target = destination;
+		if (std::filesystem::is_directory(destination, error) && !std::filesystem::is_directory(source, error)) {
+			target /= source.filename();
+		}
+		if (!std::filesystem::exists(target, error)) {
+			std::filesystem::rename(source, target, error);
+			if (!error) {
+				if (this->statistics) {
+					++this->statistics->files;
+					++this->statistics->total_files;
+				}
+				return true;
+			}
+		}
+		if (!this->copy(source, destination) || this->is_cancelled()) {
+			return false;
+		}
+		std::filesystem::remove_all(source, error);
+		if (error) {
+			this->add_error(qpl::to_string("move: couldn't remove \"", source.string(), "\": ", error.message()));
+			return false;
+		}
+		return true;
+	}
+
+	void add_file(std::vector<std::unique_ptr<file_task>>& files, const std::filesystem::path& source, const std::filesystem::path& destination) {
+		std::error_code error;
+		auto file = std::make_unique<file_task>();
+		file->source = source;
+		file->destination = destination;
+		file->size = std::filesystem::file_size(source, error);
+		file->write_time = std::filesystem::last_write_time(source, error);
+		if (this->statistics) {
+			this->statistics->total_bytes += file->size;
+			++this->statistics->total_files;
+		}
+		files.push_back(std::move(file));
+	}
+
+	bool copy_files(std::vector<std::unique_ptr<file_task>>& files) {
+		std::vector<chunk_task> chunks;
+		for (auto& file : files) {
+			if (file->size > this->chunk_size * 2 && can_copy_chunked()) {
+				if (!this->prepare_destination(*file)) {
+					continue;
+				}
+				for (qpl::u64 offset = 0u; offset < file->size; offset += this->chunk_size) {
+					chunks.push_back({ file.get(), offset, std::min(this->chunk_size, file->size - offset), false });
+					++file->remaining_chunks;
+				}
+			}
+			else {
+				file->remaining_chunks = 1u;
+				chunks.push_back({ file.get(), 0u, file->size, true });
+			}
+		}
+
+		//big work first so the tail of the copy isn't a single thread on one huge file
+		std::ranges::sort(chunks, [](const chunk_task& a, const chunk_task& b) {
+			return a.size > b.size;
+		});
+
+		std::atomic<qpl::size> next = 0u;
+		auto work = [&]() {
+			while (!this->is_cancelled()) {
+				auto index = next++;
+				if (index >= chunks.size()) {
+					return;
+				}
+				this->copy_chunk(chunks[index]);
+			}
+		};
+
+		auto threads = std::min(std::max(this->thread_count, qpl::size{ 1u }), chunks.size());
+		std::vector<std::thread> workers;
+		for (qpl::size i = 1u; i < threads; ++i) {
+			workers.emplace_back(work);
+		}
+		work();
+		for (auto& i : workers) {
+			i.join();
+		}
+		std::lock_guard lock(this->mutex);
+		return this->errors.empty();
+	}
+
+private:
+	std::mutex mutex;
+
+	void add_error(std::string message) {
+		std::lock_guard lock(this->mutex);
+		this->errors.push_back(std::move(message));
+	}
+	void finish_chunk(chunk_task& chunk, qpl::u64 bytes) {
+		if (this->statistics) {
+			this->statistics->bytes += bytes;
+		}
+		if (--chunk.file->remaining_chunks == 0u) {
+			std::error_code error;
+			if (chunk.file->permissions != std::filesystem::perms::unknown) {
+				std::filesystem::permissions(chunk.file->destination, chunk.file->permissions, std::filesystem::perm_options::replace, error);
+				if (error) {
+					this->add_error(qpl::to_string("copy: couldn't set the permissions of \"", chunk.file->destination.string(), "\": ", error.message()));
+				}
+			}
+			std::filesystem::last_write_time(chunk.file->destination, chunk.file->write_time, error);
+			if (this->statistics) {
+				++this->statistics->files;
+			}
+		}
+	}
+
+	void copy_chunk(chunk_task& chunk) {
+		if (chunk.whole_file) {
+			std::error_code error;
+			std::filesystem::copy_file(chunk.file->source, chunk.file->destination, std::filesystem::copy_options::overwrite_existing, error);
+			if (error) {
+				this->add_error(qpl::to_string("copy: \"", chunk.file->source.string(), "\": ", error.message()));
+				return;
+			}
+			this->finish_chunk(chunk, chunk.size);
+			return;
+		}
+		if (copy_range(chunk.file->source, chunk.file->destination, chunk.offset, chunk.size, this->cancel)) {
+			this->finish_chunk(chunk, chunk.size);
+		}
+		else if (!this->is_cancelled()) {
+			this->add_error(qpl::to_string("copy: \"", chunk.file->source.string(), "\" failed at offset ", chunk.offset, "."));
+		}
+	}
+
+#if defined(__linux__)
+	static bool can_copy_chunked() {
+		return true;
+	}
+	//the destination is writable by its owner while the chunks are copied, finish_chunk gives it the
+	//permission bits of the source afterwards like copy_file gives whole files
+	bool prepare_destination(file_task& file) {
+		struct stat status;
+		if (::stat(file.source.c_str(), &status) != 0) {
+			this->add_error(qpl::to_string("copy: couldn't read \"", file.source.string(), "\"."));
+			return false;
+		}
+		auto descriptor = ::open(file.destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (descriptor < 0) {
+			this->add_error(qpl::to_string("copy: couldn't open \"", file.destination.string(), "\"."));
+			return false;
+		}
+		bool result = ::ftruncate(descriptor, static_cast<off_t>(file.size)) == 0;
+		::close(descriptor);
+		file.permissions = static_cast<std::filesystem::perms>(status.st_mode & 07777);
+		if (!result) {
+			this->add_error(qpl::to_string("copy: couldn't allocate \"", file.destination.string(), "\"."));
+		}
+		return result;
+	}
+
+	//zero-copy in kernel space: copy_file_range, then sendfile for kernels / filesystems without it
+	static bool copy_range(const std::filesystem::path& source, const std::filesystem::path& destination, qpl::u64 offset, qpl::u64 size, const std::atomic_bool* cancel) {
+		auto in = ::open(source.c_str(), O_RDONLY);
+		if (in < 0) {
+			return false;
+		}
+		auto out = ::open(destination.c_str(), O_WRONLY);
+		if (out < 0) {
+			::close(in);
+			return false;
+		}
+
+		constexpr qpl::u64 step = 8u * 1024u * 1024u;
+		loff_t in_offset = static_cast<loff_t>(offset);
+		loff_t out_offset = static_cast<loff_t>(offset);
+		qpl::u64 left = size;
+		bool use_sendfile = false;
+		while (left) {
+			if (cancel && cancel->load()) {
+				break;
+			}
+			auto count = static_cast<size_t>(std::min(left, step));
+			ssize_t written = -1;
+			if (!use_sendfile) {
+				written = ::copy_file_range(in, &in_offset, out, &out_offset, count, 0u);
+				if (written < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+					use_sendfile = true;
+					continue;
+				}
+			}
+			else {
+				if (::lseek(out, out_offset, SEEK_SET) < 0) {
+					break;
+				}
+				off_t sendfile_offset = static_cast<off_t>(in_offset);
+				written = ::sendfile(out, in, &sendfile_offset, count);
+				if (written > 0) {
+					in_offset += written;
+					out_offset += written;
+				}
+			}
+			if (written <= 0) {
+				break;
+			}
+			left -= static_cast<qpl::u64>(written);
+		}
+		::close(in);
+		::close(out);
+		return left == 0u;
+	}
+#else
+	static bool can_copy_chunked() {
+		return false;
+	}
+	bool prepare_destination(file_task&) {
+		return true;
+	}
+	static bool copy_range(const std::filesystem::path&, const std::filesystem::path&, qpl::u64, qpl::u64, const std::atomic_bool*) {
+		return false;
+	}
+#endif
+};
@@ -1,72 +1,194 @@
 #pragma once
 #include <qpl/qpl.hpp>
 #include "config.hpp"
+#include "profiler.hpp"
+#include "script_executor.hpp"
+#include "script_watcher.hpp"
 
+//state of the checkmark button below a script widget. its chrome is written into the widget batch from the
+//hitbox and the current colors, so a script holds no drawables of its own apart from the job status text
 struct executable_script {
-	qsf::smooth_rectangle background;
-	qsf::smooth_rectangle checkmark_box;
-	qsf::smooth_corner corner;
-	qsf::vertex_array checkmark;
+	//only created once a job reports statistics
+	std::unique_ptr<qsf::text> status;
+	bool show_status = false;
 	qpl::hitbox hitbox;
 	bool hovering = false;
 	bool clicked = false;
+	bool geometry_changed = true;
 	qpl::animation checkmark_hovering_animation;
+	qpl::f64 hovering_progress = 0.0;
+
+	std::shared_ptr<const compiled_script> compiled;
+	std::shared_ptr<script_job> job;
+	std::shared_ptr<script_watch> watch;
+	script_state displayed_state = script_state::idle;
+	qpl::f64 displayed_progress = 0.0;
+
 	constexpr static qpl::rgb checkmark_color = qpl::rgb(138, 226, 138);
+	constexpr static qpl::rgb checkmark_running_color = qpl::rgb(226, 200, 100);
+	constexpr static qpl::rgb checkmark_failed_color = qpl::rgb(226, 100, 100);
+	constexpr static qpl::rgb checkmark_cancelled_color = qpl::rgb::grey_shade(150);
 	constexpr static qpl::rgb checkmark_box_color = qpl::rgb::grey_shade(30);
+	constexpr static qpl::rgb progress_bar_color = qpl::rgb(100, 160, 226);
+	qpl::rgb current_background_color = qpl::rgb::grey_shade(100);
+	qpl::rgb current_checkmark_color = checkmark_color;
+	qpl::rgb current_checkmark_box_color = checkmark_box_color;
 
 	executable_script() {
 		this->hitbox.set_dimension({ 130, 130 });
 		this->hitbox.set_center({ 0, 0 });
+		this->checkmark_hovering_animation.set_duration(0.2);
+	}
+	executable_script(const executable_script& other) {
+		*this = other;
+	}
+	executable_script& operator=(const executable_script& other) {
+		this->status = other.status ? std::make_unique<qsf::text>(*other.status) : nullptr;
+		this->show_status = other.show_status;
+		this->hitbox = other.hitbox;
+		this->hovering = other.hovering;
+		this->clicked = other.clicked;
+		this->geometry_changed = true;
+		this->checkmark_hovering_animation = other.checkmark_hovering_animation;
+		this->hovering_progress = other.hovering_progress;
+		this->compiled = other.compiled;
+		this->job = other.job;
+		this->watch = other.watch;
+		this->displayed_state = other.displayed_state;
+		this->displayed_progress = other.displayed_progress;
+		this->current_background_color = other.current_background_color;
+		this->current_checkmark_color = other.current_checkmark_color;
+		this->current_checkmark_box_color = other.current_checkmark_box_color;
+		return *this;
+	}
 
-		this->background.set_hitbox(this->hitbox.extended_up(60));
-		this->background.set_slope_dimension(config::widget_background_slope_dimension);
-		this->background.round_corners[0] = false;
-		this->background.round_corners[1] = false;
-
-		this->checkmark_box.set_dimension({ 90, 90 });
-		this->checkmark_box.set_center(this->hitbox.get_center());
-		this->checkmark_box.set_slope_dimension(config::widget_slope_dimension);
-		this->checkmark_box.set_color(this->checkmark_box_color);
-		this->checkmark_box.set_outline_thickness(5.0f);
-		this->checkmark_box.set_outline_color(qpl::rgb::black());
+	qpl::hitbox get_hitbox() const {
+		return this->hitbox;
+	}
+	qpl::hitbox get_progress_hitbox() const {
+		qpl::hitbox result;
+		result.position = this->hitbox.get_center() + qpl::vec(-35, 27);
+		result.dimension = qpl::vec(static_cast<qpl::f32>(70 * this->displayed_progress), 8);
+		return result;
+	}
 
-		this->checkmark.resize(3u);
-		this->checkmark.set_primitive_type(sf::PrimitiveType::Triangles);
-		this->checkmark[0].position = qpl::vec(-1, -1) * 20;
-		this->checkmark[1].position = qpl::vec(0.75, 0) * 20;
-		this->checkmark[2].position = qpl::vec(-1, 1) * 20;
+	qpl::vec2 get_status_position() const {
+		return this->hitbox.get_bottom_left() + qpl::vec(0, 10);
+	}
+	std::array<qpl::vec2, 3u> get_checkmark() const {
+		auto center = this->hitbox.get_center() + qpl::vec(5, 0);
+		return { center + qpl::vec(-1, -1) * 20, center + qpl::vec(0.75, 0) * 20, center + qpl::vec(-1, 1) * 20 };
+	}
 
-		for (auto& i : this->checkmark) {
-			i.color = this->checkmark_color;
-			i.position += qpl::vec(5, 0);
+	bool is_job_active() const {
+		return this->job && !this->job->is_finished();
+	}
+	void reset_job() {
+		this->job.reset();
+		this->update_job();
+	}
+	//clicking a running script cancels it, otherwise a new job gets queued
+	void toggle_job() {
+		if (this->is_job_active()) {
+			this->job->cancel();
 		}
+		else if (this->compiled) {
+			this->job = get_script_executor().submit(this->compiled);
+		}
+		this->update_job();
+	}
 
-		this->corner.set_dimension({ 40, 40 });
-		this->corner.set_slope_point_count(40);
-		this->corner.invert();
-		this->corner.set_rotation(qpl::pi);
-
-		auto h = this->corner.get_hitbox();
-		h.set_top_right(this->hitbox.get_top_left() + qpl::vec(0, 15));
-		this->corner.set_hitbox(h);
-
-		this->checkmark_hovering_animation.set_duration(0.2);
+	//recompiled whenever the widget text changes, syntax errors show up as a red checkmark
+	void compile(const text_rope& text) {
+		this->compiled = compile_script(text);
+		this->update_watch();
+		this->update_checkmark_color();
+	}
+	//scripts with a watch line rerun by themselves, their jobs are picked up in update_job.
+	//clones share one watch, it's only reused in place while no other script holds it
+	void update_watch() {
+		auto existing = this->watch.use_count() == 1 ? this->watch : nullptr;
+		this->watch = get_script_watcher().watch(this->compiled, std::move(existing));
+	}
+	bool has_new_watch_job() const {
+		return this->watch && this->watch->job_started;
+	}
+	bool has_syntax_errors() const {
+		return this->compiled && this->compiled->has_errors();
+	}
+	void print_syntax_errors() const {
+		if (this->has_syntax_errors()) {
+			for (auto& error : this->compiled->errors) {
+				qpl::println(qpl::foreground::red, "syntax error: ", error.string());
+			}
+		}
 	}
 
-	qpl::hitbox get_hitbox() const {
-		return this->hitbox;
+	qpl::rgb get_state_color() const {
+		switch (this->displayed_state) {
+		case script_state::queued:
+		case script_state::running:
+			return this->checkmark_running_color;
+		case script_state::failed:
+			return this->checkmark_failed_color;
+		case script_state::cancelled:
+			return this->checkmark_cancelled_color;
+		default:
+			if (this->has_syntax_errors()) {
+				return this->checkmark_failed_color;
+			}
+			return this->checkmark_color;
+		}
+	}
+	void update_checkmark_color() {
+		this->current_checkmark_color = this->get_state_color().lighted(this->hovering_progress / 2);
+		this->current_checkmark_box_color = this->checkmark_box_color.darkened(this->hovering_progress);
+		this->geometry_changed = true;
+	}
+	void update_status() {
+		this->show_status = this->job && this->job->statistics.total_files.load();
+		if (!this->show_status) {
+			return;
+		}
+		if (!this->status) {
+			this->status = std::make_unique<qsf::text>();
+			this->status->set_font("consola");
+			this->status->set_character_size(20);
+			this->status->set_color(qpl::rgb::grey_shade(200));
+			this->status->set_position(this->get_status_position());
+		}
+		this->status->set_string(this->job->statistics.string());
+	}
+	void update_job() {
+		if (this->watch) {
+			if (auto job = this->watch->take_job()) {
+				this->job = std::move(job);
+			}
+		}
+		if (this->job && this->job->state == script_state::running) {
+			this->update_status();
+		}
+		auto state = this->job ? this->job->state.load() : script_state::idle;
+		auto progress = state == script_state::running ? this->job->get_progress() : 0.0;
+		if (state == this->displayed_state && progress == this->displayed_progress) {
+			return;
+		}
+		this->displayed_state = state;
+		this->displayed_progress = progress;
+		this->update_status();
+		this->update_checkmark_color();
 	}
 
 	void set_background_color(qpl::rgb color) {
-		this->background.set_color(color);
-		this->corner.set_color(color);
+		this->current_background_color = color;
+		this->geometry_changed = true;
 	}
 	void move(qpl::vec2 delta) {
-		this->background.move(delta);
-		this->checkmark.move(delta);
-		this->checkmark_box.move(delta);
-		this->corner.move(delta);
 		this->hitbox.move(delta);
+		if (this->status) {
+			this->status->set_position(this->get_status_position());
+		}
+		this->geometry_changed = true;
 	}
 	void update_position(qpl::hitbox hitbox) {
 		qpl::hitbox new_hitbox = this->hitbox;
@@ -87,18 +209,15 @@ struct executable_script {
 
 		this->checkmark_hovering_animation.update(event);
 		if (this->checkmark_hovering_animation.is_running()) {
-			auto p = this->checkmark_hovering_animation.get_curve_progress();
-			auto color = this->checkmark_color.lighted(p / 2);
-			this->checkmark.set_color(color);
-
-			color = this->checkmark_box_color.darkened(p);
-			this->checkmark_box.set_color(color);
+			this->hovering_progress = this->checkmark_hovering_animation.get_curve_progress();
+			this->update_checkmark_color();
 		}
+		this->update_job();
 	}
-	void draw(qsf::draw_object& draw) const {
-		draw.draw(this->background);
-		draw.draw(this->checkmark_box);
-		draw.draw(this->checkmark);
-		draw.draw(this->corner);
+	void draw_status(qsf::draw_object& draw) const {
+		if (this->show_status && this->status) {
+			draw.draw(*this->status);
+			get_profiler().count(profile_counter::draw_calls);
+		}
 	}
 };
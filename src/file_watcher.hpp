@@ -0,0 +1,555 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "paths.hpp"
+#include "config.hpp"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <condition_variable>
+#endif
+
+//reports changes below a set of paths on its own thread. on linux every directory of a watched tree gets an
+//inotify watch and the thread sleeps in poll until something happens. on windows every root gets one
+//recursive ReadDirectoryChangesW and the thread sleeps on their completion port. elsewhere the trees are
+//rescanned every config::file_watch_poll_interval seconds. add and remove only queue the request, the
+//watches are set up and torn down on the watcher thread, which also runs the callbacks.
+struct file_watcher {
+	using callback = std::function<void(const std::string& path)>;
+
+	struct subscription {
+		std::string root;
+		callback function;
+		qpl::u64 signature = 0u;
+	};
+	std::unordered_map<qpl::size, subscription> subscriptions;
+	//subscriptions the watcher thread hasn't set up yet
+	std::vector<qpl::size> added;
+	bool prune_due = false;
+	qpl::size next_id = 1u;
+	std::mutex mutex;
+	std::thread worker;
+	bool stopping = false;
+
+#if defined(__linux__)
+	int inotify = -1;
+	int wake_descriptor = -1;
+	std::unordered_map<int, std::string> directories;
+	std::unordered_map<std::string, int> descriptors;
+#elif defined(_WIN32)
+	//one pending ReadDirectoryChangesW, its completion key is the watch itself
+	struct directory_watch {
+		std::string directory;
+		bool recursive = false;
+		HANDLE handle = INVALID_HANDLE_VALUE;
+		OVERLAPPED overlapped{};
+		alignas(DWORD) std::array<char, 64u * 1024u> buffer;
+	};
+	HANDLE port = nullptr;
+	std::unordered_map<std::string, std::unique_ptr<directory_watch>> watches;
+	//cancelled watches stay alive until their aborted read completed
+	std::vector<std::unique_ptr<directory_watch>> closing;
+#else
+	std::condition_variable condition;
+#endif
+
+	file_watcher() {
+#if defined(__linux__)
+		this->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		this->wake_descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (this->inotify < 0 || this->wake_descriptor < 0) {
+			qpl::println("file_watcher: couldn't initialize inotify, watch mode is disabled.");
+			return;
+		}
+#elif defined(_WIN32)
+		this->port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		if (!this->port) {
+			qpl::println("file_watcher: couldn't create a completion port, watch mode is disabled.");
+			return;
+		}
+#endif
+		this->worker = std::thread([this]() {
+			this->work();
+		});
+	}
+	~file_watcher() {
+		{
+			std::lock_guard lock(this->mutex);
+			this->stopping = true;
+		}
+		this->wake();
+		if (this->worker.joinable()) {
+			this->worker.join();
+		}
+#if defined(__linux__)
+		if (this->inotify >= 0) {
+			::close(this->inotify);
+		}
+		if (this->wake_descriptor >= 0) {
+			::close(this->wake_descriptor);
+		}
+#elif defined(_WIN32)
+		if (this->port) {
+			CloseHandle(this->port);
+		}
+#endif
+	}
+	file_watcher(const file_watcher&) = delete;
+	file_watcher& operator=(const file_watcher&) = delete;
+
+	//the callback gets the changed path, which is inside the root or, if the root was created or removed, above it.
+	//changes are reported once the watcher thread has set the root up
+	qpl::size add(const std::string& path, callback function) {
+		qpl::size id = 0u;
+		{
+			std::lock_guard lock(this->mutex);
+			id = this->next_id++;
+			auto& subscription = this->subscriptions[id];
+			subscription.root = normalize_path(path);
+			subscription.function = std::move(function);
+			this->added.push_back(id);
+		}
+		this->wake();
+		return id;
+	}
+	void remove(qpl::size id) {
+		{
+			std::lock_guard lock(this->mutex);
+			this->subscriptions.erase(id);
+			this->prune_due = true;
+		}
+		this->wake();
+	}
+
+private:
+	void wake() {
+#if defined(__linux__)
+		if (this->wake_descriptor >= 0) {
+			qpl::u64 one = 1u;
+			[[maybe_unused]] auto written = ::write(this->wake_descriptor, &one, sizeof(one));
+		}
+#elif defined(_WIN32)
+		if (this->port) {
+			PostQueuedCompletionStatus(this->port, 0, 0, nullptr);
+		}
+#else
+		this->condition.notify_all();
+#endif
+	}
+	//sets up the subscriptions added since the last wakeup and drops watches nobody needs anymore.
+	//a subscription that was removed again before its turn never gets a watch. false once stopping
+	bool apply_requests() {
+		std::lock_guard lock(this->mutex);
+		if (this->stopping) {
+			return false;
+		}
+		for (auto& id : this->added) {
+			auto subscription = this->subscriptions.find(id);
+			if (subscription == this->subscriptions.cend()) {
+				continue;
+			}
+#if defined(__linux__) || defined(_WIN32)
+			this->watch_root(subscription->second.root);
+#else
+			subscription->second.signature = signature(subscription->second.root);
+#endif
+		}
+		this->added.clear();
+		if (this->prune_due) {
+#if defined(__linux__) || defined(_WIN32)
+			this->prune();
+#endif
+			this->prune_due = false;
+		}
+		return true;
+	}
+
+	std::vector<callback> get_callbacks(const std::string& path) {
+		std::vector<callback> result;
+		for (auto& [id, subscription] : this->subscriptions) {
+			if (paths_overlap(subscription.root, path)) {
+				result.push_back(subscription.function);
+			}
+		}
+		return result;
+	}
+
+#if defined(__linux__)
+	void watch_directory(const std::string& directory) {
+		if (this->descriptors.contains(directory)) {
+			return;
+		}
+		constexpr auto mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+		auto descriptor = inotify_add_watch(this->inotify, directory.c_str(), mask);
+		if (descriptor < 0) {
+			return;
+		}
+		this->directories[descriptor] = directory;
+		this->descriptors[directory] = descriptor;
+	}
+	void watch_tree(const std::string& directory) {
+		this->watch_directory(directory);
+		std::error_code error;
+		auto options = std::filesystem::directory_options::skip_permission_denied;
+		for (auto it = std::filesystem::recursive_directory_iterator(directory, options, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+			if (it->is_directory(error) && !it->is_symlink(error)) {
+				this->watch_directory(normalize_path(it->path().string()));
+			}
+		}
+	}
+	//a missing root is watched through its closest existing parent until it shows up
+	void watch_root(const std::string& root) {
+		std::error_code error;
+		std::filesystem::path path = root;
+		if (std::filesystem::is_directory(path, error)) {
+			this->watch_tree(root);
+			return;
+		}
+		path = path.parent_path();
+		while (!path.empty() && !std::filesystem::is_directory(path, error)) {
+			if (path == path.parent_path()) {
+				return;
+			}
+			path = path.parent_path();
+		}
+		if (!path.empty()) {
+			this->watch_directory(normalize_path(path.string()));
+		}
+	}
+	//directories that no root needs anymore lose their watch
+	void prune() {
+		for (auto it = this->descriptors.begin(); it != this->descriptors.end();) {
+			bool needed = std::ranges::any_of(this->subscriptions, [&](const auto& subscription) {
+				return paths_overlap(subscription.second.root, it->first);
+			});
+			if (needed) {
+				++it;
+				continue;
+			}
+			inotify_rm_watch(this->inotify, it->second);
+			this->directories.erase(it->second);
+			it = this->descriptors.erase(it);
+		}
+	}
+
+	void work() {
+		std::array<pollfd, 2u> descriptors = { pollfd{ this->inotify, POLLIN, 0 }, pollfd{ this->wake_descriptor, POLLIN, 0 } };
+		alignas(inotify_event) std::array<char, 64u * 1024u> buffer;
+		while (true) {
+			if (::poll(descriptors.data(), descriptors.size(), -1) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				qpl::println("file_watcher: poll failed, watch mode stopped.");
+				return;
+			}
+			if (descriptors[1].revents & POLLIN) {
+				qpl::u64 count = 0u;
+				[[maybe_unused]] auto read = ::read(this->wake_descriptor, &count, sizeof(count));
+				if (!this->apply_requests()) {
+					return;
+				}
+			}
+			if (!(descriptors[0].revents & POLLIN)) {
+				continue;
+			}
+
+			std::vector<std::pair<callback, std::string>> calls;
+			while (true) {
+				auto size = ::read(this->inotify, buffer.data(), buffer.size());
+				if (size <= 0) {
+					break;
+				}
+				std::lock_guard lock(this->mutex);
+				for (qpl::size offset = 0u; offset < static_cast<qpl::size>(size);) {
+					auto& event = *reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+					offset += sizeof(inotify_event) + event.len;
+
+					if (event.mask & IN_Q_OVERFLOW) {
+						for (auto& [id, subscription] : this->subscriptions) {
+							calls.emplace_back(subscription.function, subscription.root);
+						}
+						continue;
+					}
+					auto directory = this->directories.find(event.wd);
+					if (directory == this->directories.cend()) {
+						continue;
+					}
+					if (event.mask & IN_IGNORED) {
+						this->descriptors.erase(directory->second);
+						this->directories.erase(directory);
+						continue;
+					}
+					auto path = event.len ? directory->second + '/' + event.name : directory->second;
+					if ((event.mask & IN_ISDIR) && (event.mask & (IN_CREATE | IN_MOVED_TO))) {
+						for (auto& [id, subscription] : this->subscriptions) {
+							if (path_contains(subscription.root, path)) {
+								this->watch_tree(path);
+							}
+							else if (path_contains(path, subscription.root)) {
+								this->watch_root(subscription.root);
+							}
+						}
+					}
+					for (auto& function : this->get_callbacks(path)) {
+						calls.emplace_back(std::move(function), path);
+					}
+				}
+			}
+			for (auto& [function, path] : calls) {
+				function(path);
+			}
+		}
+	}
+#elif defined(_WIN32)
+	//opens the directory and queues its first read, a watch that already covers at least as much is kept
+	void watch_directory(const std::string& directory, bool recursive) {
+		auto& watch = this->watches[directory];
+		if (watch && (watch->recursive || !recursive)) {
+			return;
+		}
+		if (watch) {
+			this->close_watch(std::move(watch));
+		}
+		auto result = std::make_unique<directory_watch>();
+		result->directory = directory;
+		result->recursive = recursive;
+		result->handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+		if (result->handle == INVALID_HANDLE_VALUE) {
+			this->watches.erase(directory);
+			return;
+		}
+		if (!CreateIoCompletionPort(result->handle, this->port, reinterpret_cast<ULONG_PTR>(result.get()), 0) || !this->read(*result)) {
+			CloseHandle(result->handle);
+			this->watches.erase(directory);
+			return;
+		}
+		watch = std::move(result);
+	}
+	bool read(directory_watch& watch) {
+		constexpr DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+		watch.overlapped = OVERLAPPED{};
+		return ReadDirectoryChangesW(watch.handle, watch.buffer.data(), static_cast<DWORD>(watch.buffer.size()), watch.recursive, filter, nullptr, &watch.overlapped, nullptr);
+	}
+	//the pending read completes as aborted, only then the watch may be freed
+	void close_watch(std::unique_ptr<directory_watch>&& watch) {
+		CancelIoEx(watch->handle, &watch->overlapped);
+		CloseHandle(watch->handle);
+		watch->handle = INVALID_HANDLE_VALUE;
+		this->closing.push_back(std::move(watch));
+	}
+	//an existing root is watched recursively, a missing one through its closest existing parent until it shows up
+	void watch_root(const std::string& root) {
+		std::error_code error;
+		std::filesystem::path path = root;
+		if (std::filesystem::is_directory(path, error)) {
+			this->watch_directory(root, true);
+			return;
+		}
+		path = path.parent_path();
+		while (!path.empty() && !std::filesystem::is_directory(path, error)) {
+			if (path == path.parent_path()) {
+				return;
+			}
+			path = path.parent_path();
+		}
+		if (!path.empty()) {
+			this->watch_directory(normalize_path(path.string()), false);
+		}
+	}
+	void prune() {
+		for (auto it = this->watches.begin(); it != this->watches.end();) {
+			bool needed = std::ranges::any_of(this->subscriptions, [&](const auto& subscription) {
+				return paths_overlap(subscription.second.root, it->first);
+			});
+			if (needed) {
+				++it;
+				continue;
+			}
+			this->close_watch(std::move(it->second));
+			it = this->watches.erase(it);
+		}
+	}
+	//waits for the aborted reads of every watch before they are freed
+	void close_all() {
+		for (auto& [directory, watch] : this->watches) {
+			this->close_watch(std::move(watch));
+		}
+		this->watches.clear();
+		while (!this->closing.empty()) {
+			DWORD bytes = 0;
+			ULONG_PTR key = 0;
+			OVERLAPPED* overlapped = nullptr;
+			GetQueuedCompletionStatus(this->port, &bytes, &key, &overlapped, 1000);
+			if (!overlapped) {
+				if (GetLastError() == WAIT_TIMEOUT) {
+					return;
+				}
+				continue;
+			}
+			std::erase_if(this->closing, [&](const std::unique_ptr<directory_watch>& watch) {
+				return reinterpret_cast<ULONG_PTR>(watch.get()) == key;
+			});
+		}
+	}
+
+	void work() {
+		while (true) {
+			DWORD bytes = 0;
+			ULONG_PTR key = 0;
+			OVERLAPPED* overlapped = nullptr;
+			bool success = GetQueuedCompletionStatus(this->port, &bytes, &key, &overlapped, INFINITE);
+			//no overlapped means a wakeup from add, remove or the destructor
+			if (!overlapped) {
+				if (!success) {
+					qpl::println("file_watcher: waiting for changes failed, watch mode stopped.");
+					return;
+				}
+				if (!this->apply_requests()) {
+					std::lock_guard lock(this->mutex);
+					this->close_all();
+					return;
+				}
+				continue;
+			}
+
+			std::vector<std::pair<callback, std::string>> calls;
+			{
+				std::lock_guard lock(this->mutex);
+				auto closed = std::ranges::find_if(this->closing, [&](const std::unique_ptr<directory_watch>& watch) {
+					return reinterpret_cast<ULONG_PTR>(watch.get()) == key;
+				});
+				if (closed != this->closing.end()) {
+					this->closing.erase(closed);
+					continue;
+				}
+				auto& watch = *reinterpret_cast<directory_watch*>(key);
+				auto directory = watch.directory;
+				if (!success || bytes == 0u) {
+					//the directory went away or the buffer overflowed, anything below it may have changed
+					for (auto& function : this->get_callbacks(directory)) {
+						calls.emplace_back(std::move(function), directory);
+					}
+				}
+				else {
+					for (qpl::size offset = 0u;;) {
+						auto& information = *reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(watch.buffer.data() + offset);
+						std::wstring name(information.FileName, information.FileNameLength / sizeof(WCHAR));
+						auto path = (std::filesystem::path(directory) / name).generic_string();
+						//a parent watch of a missing root, the root might have just been created
+						bool created = information.Action == FILE_ACTION_ADDED || information.Action == FILE_ACTION_RENAMED_NEW_NAME;
+						if (created && !watch.recursive) {
+							for (auto& [id, subscription] : this->subscriptions) {
+								if (path_contains(path, subscription.root)) {
+									this->watch_root(subscription.root);
+								}
+							}
+						}
+						for (auto& function : this->get_callbacks(path)) {
+							calls.emplace_back(std::move(function), path);
+						}
+						if (!information.NextEntryOffset) {
+							break;
+						}
+						offset += information.NextEntryOffset;
+					}
+				}
+				//watch_root may have replaced this watch with a recursive one. a watch that can't read again has
+				//nothing pending anymore, so it's freed right away and its roots are resolved again
+				auto current = this->watches.find(directory);
+				if (current != this->watches.end() && current->second.get() == &watch && (!success || !this->read(watch))) {
+					CloseHandle(watch.handle);
+					this->watches.erase(current);
+					for (auto& [id, subscription] : this->subscriptions) {
+						if (paths_overlap(subscription.root, directory)) {
+							this->watch_root(subscription.root);
+						}
+					}
+				}
+			}
+			for (auto& [function, path] : calls) {
+				function(path);
+			}
+		}
+	}
+#else
+	//cheap fingerprint of a tree, any added, removed, resized or touched file changes it
+	static qpl::u64 signature(const std::string& root) {
+		auto hash = 0xCBF29CE484222325ull;
+		auto add = [&](qpl::u64 value) {
+			hash ^= value;
+			hash *= 0x100000001B3ull;
+		};
+		std::error_code error;
+		auto add_entry = [&](const std::filesystem::directory_entry& entry) {
+			add(std::hash<std::string>{}(entry.path().generic_string()));
+			add(static_cast<qpl::u64>(entry.last_write_time(error).time_since_epoch().count()));
+			if (entry.is_regular_file(error)) {
+				add(entry.file_size(error));
+			}
+		};
+		std::filesystem::directory_entry root_entry(root, error);
+		if (!root_entry.exists(error)) {
+			return 0u;
+		}
+		add_entry(root_entry);
+		if (root_entry.is_directory(error)) {
+			auto options = std::filesystem::directory_options::skip_permission_denied;
+			for (auto it = std::filesystem::recursive_directory_iterator(root, options, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+				add_entry(*it);
+			}
+		}
+		return hash;
+	}
+
+	void work() {
+		std::unique_lock lock(this->mutex);
+		while (true) {
+			auto interval = std::chrono::duration<qpl::f64>(config::file_watch_poll_interval);
+			this->condition.wait_for(lock, interval, [&]() {
+				return this->stopping || !this->added.empty() || this->prune_due;
+			});
+			if (!this->added.empty() || this->prune_due) {
+				lock.unlock();
+				bool running = this->apply_requests();
+				lock.lock();
+				if (!running) {
+					return;
+				}
+				continue;
+			}
+			if (this->stopping) {
+				return;
+			}
+			std::vector<std::pair<callback, std::string>> calls;
+			for (auto& [id, subscription] : this->subscriptions) {
+				auto signature = file_watcher::signature(subscription.root);
+				if (signature != subscription.signature) {
+					subscription.signature = signature;
+					calls.emplace_back(subscription.function, subscription.root);
+				}
+			}
+			lock.unlock();
+			for (auto& [function, path] : calls) {
+				function(path);
+			}
+			lock.lock();
+		}
+	}
+#endif
+};
+
+inline file_watcher& get_file_watcher() {
+	static file_watcher watcher;
+	return watcher;
+}
@@ -1,5 +1,23 @@
 #include <qpl/qpl.hpp>
 #include "widgets.hpp"
+#include "autosave.hpp"
+#include "profiler.hpp"
+#include "search_bar.hpp"
+
+//feeds the allocation counter of the profiler
+void* operator new(std::size_t size) {
+	allocation_count.fetch_add(1u, std::memory_order_relaxed);
+	if (auto pointer = std::malloc(size ? size : 1u)) {
+		return pointer;
+	}
+	throw std::bad_alloc{};
+}
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+void operator delete(void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
 
 struct main_state : qsf::base_state {
 	void init() override {
@@ -18,25 +36,15 @@ struct main_state : qsf::base_state {
 		if (this->save_on_close) {
 			this->save();
 		}
+		this->autosave.wait();
 	}
 
 	void save() {
-		qpl::save_state state;
-		state.save(this->widgets, this->view.position, this->view.scale, crypto::check);
-	
-		auto str = qpl::encrypted_keep_size(state.get_finalized_string(), crypto::key);
-		qpl::write_data_file(str, "data/session.dat");
+		this->autosave.submit(this->widgets, this->view);
 	}
 	void load() {
-		auto data = qpl::filesys::read_file("data/session.dat");
-		qpl::decrypt_keep_size(data, crypto::key);
-	
-		std::array<qpl::u64, 4u> confirm;
-		qpl::load_state state;
-		state.set_string(data);
-		state.load(this->widgets, this->view.position, this->view.scale, confirm);
-	
-		if (confirm != crypto::check) {
+		this->autosave.wait();
+		if (!this->session.load(this->widgets, this->view)) {
 			qpl::println("couldn't load session!");
 			this->widgets.load_default();
 			return;
@@ -44,8 +52,16 @@ struct main_state : qsf::base_state {
 	}
 
 	void updating() override {
+		get_profiler().next_frame();
+		this->profiler_overlay.update(this->event());
 		this->update(this->color_picker, this->view);
 
+		auto target = this->search_bar.update(this->event(), this->widgets);
+		this->widgets.keyboard_captured = this->search_bar.has_focus();
+		if (this->widgets.index_of(target) != qpl::size_max) {
+			this->jump_to(target);
+		}
+
 		if (this->event().key_holding(sf::Keyboard::LControl)) {
 			if (this->event().key_pressed(sf::Keyboard::R)) {
 				this->view.reset();
@@ -65,18 +81,45 @@ struct main_state : qsf::base_state {
 		this->update(this->widgets, this->view);
 		this->view.allow_dragging = this->widgets.allow_view_drag && !this->color_picker.has_focus();
 		this->update(this->view);
+
+		this->autosave.update(this->frame_time_f(), this->widgets, this->view);
+	}
+
+	//centers the widget, zooms out if it doesn't fit and in if the text would be unreadable
+	void jump_to(widget_handle handle) {
+		auto bounds = this->widgets.get_bounds(this->widgets.index_of(handle));
+		auto screen = qpl::vec2(this->dimension());
+		auto fit = std::max(bounds.dimension.x / (screen.x * config::search_jump_fill), bounds.dimension.y / (screen.y * config::search_jump_fill));
+		auto scale = std::max(fit, std::min(this->view.scale.x, 1.f));
+		this->view.set_scale(qpl::vec(scale, scale));
+		this->view.set_position(bounds.get_center() - screen * scale / 2);
+		this->widgets.select(handle);
+	}
+
+	qpl::hitbox get_visible_hitbox() const {
+		qpl::hitbox hitbox;
+		hitbox.position = this->view.position;
+		hitbox.dimension = qpl::vec2(this->dimension()) * this->view.scale;
+		return hitbox;
 	}
 
 	void drawing() override {
+		this->widgets.set_visible_hitbox(this->get_visible_hitbox(), this->view.scale.x);
 		this->draw(this->widgets, this->view);
 		this->draw(this->color_picker, this->view);
+		this->draw(this->search_bar);
+		this->draw(this->profiler_overlay);
 	}
 	qsf::view_control view;
 	qpl::size side = 0u;
 	widgets widgets;
-	bool save_on_close = false;
+	session_store session;
+	::autosave autosave{ this->session };
+	bool save_on_close = config::autosave_on_close;
 
 	qsf::view_extension<qsf::color_picker> color_picker;
+	::search_bar search_bar;
+	profiler_overlay profiler_overlay;
 };
 
 int main() try {
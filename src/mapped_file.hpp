@@ -0,0 +1,127 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <string>
+#include <string_view>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//read-only memory mapping of a whole file, the mapping keeps seeing the contents it was opened with.
+//on posix the file can be replaced by rename while it's mapped. windows refuses to replace or delete a
+//mapped file, it can only be renamed itself (it's opened with FILE_SHARE_DELETE for that), see session_store::write_atomic
+struct mapped_file {
+	const char* data = nullptr;
+	qpl::size size = 0u;
+
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int descriptor = -1;
+#endif
+
+	mapped_file() = default;
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file(mapped_file&& other) noexcept {
+		*this = std::move(other);
+	}
+	mapped_file& operator=(mapped_file&& other) noexcept {
+		if (this != &other) {
+			this->close();
+			std::swap(this->data, other.data);
+			std::swap(this->size, other.size);
+#if defined(_WIN32)
+			std::swap(this->file, other.file);
+			std::swap(this->mapping, other.mapping);
+#else
+			std::swap(this->descriptor, other.descriptor);
+#endif
+		}
+		return *this;
+	}
+	~mapped_file() {
+		this->close();
+	}
+
+	bool open(const std::string& path) {
+		this->close();
+#if defined(_WIN32)
+		this->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (this->file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(this->file, &file_size) || file_size.QuadPart == 0) {
+			this->close();
+			return false;
+		}
+		this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!this->mapping) {
+			this->close();
+			return false;
+		}
+		this->data = static_cast<const char*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+		this->size = static_cast<qpl::size>(file_size.QuadPart);
+#else
+		this->descriptor = ::open(path.c_str(), O_RDONLY);
+		if (this->descriptor < 0) {
+			return false;
+		}
+		struct stat status;
+		if (fstat(this->descriptor, &status) != 0 || status.st_size == 0) {
+			this->close();
+			return false;
+		}
+		auto address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, this->descriptor, 0);
+		if (address == MAP_FAILED) {
+			this->close();
+			return false;
+		}
+		this->data = static_cast<const char*>(address);
+		this->size = static_cast<qpl::size>(status.st_size);
+#endif
+		if (!this->data) {
+			this->close();
+			return false;
+		}
+		return true;
+	}
+	void close() {
+#if defined(_WIN32)
+		if (this->data) {
+			UnmapViewOfFile(this->data);
+		}
+		if (this->mapping) {
+			CloseHandle(this->mapping);
+		}
+		if (this->file != INVALID_HANDLE_VALUE) {
+			CloseHandle(this->file);
+		}
+		this->mapping = nullptr;
+		this->file = INVALID_HANDLE_VALUE;
+#else
+		if (this->data) {
+			munmap(const_cast<char*>(this->data), this->size);
+		}
+		if (this->descriptor >= 0) {
+			::close(this->descriptor);
+		}
+		this->descriptor = -1;
+#endif
+		this->data = nullptr;
+		this->size = 0u;
+	}
+	bool is_open() const {
+		return this->data != nullptr;
+	}
+	std::string_view view() const {
+		return std::string_view(this->data, this->size);
+	}
+};
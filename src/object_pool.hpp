@@ -0,0 +1,66 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <memory>
+#include <new>
+
+//fixed size block allocator for one type, blocks come from large chunks and are recycled through a free list.
+//only used from the ui thread
+template<typename T>
+struct object_pool {
+	union block {
+		block* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+	std::vector<std::unique_ptr<block[]>> chunks;
+	block* free_list = nullptr;
+	qpl::size chunk_size = 64u;
+
+	void* allocate() {
+		if (!this->free_list) {
+			auto chunk = std::make_unique<block[]>(this->chunk_size);
+			for (qpl::size i = 0u; i < this->chunk_size; ++i) {
+				chunk[i].next = this->free_list;
+				this->free_list = &chunk[i];
+			}
+			this->chunks.push_back(std::move(chunk));
+			this->chunk_size *= 2u;
+		}
+		auto result = this->free_list;
+		this->free_list = result->next;
+		return result->storage;
+	}
+	void deallocate(void* pointer) {
+		auto released = reinterpret_cast<block*>(pointer);
+		released->next = this->free_list;
+		this->free_list = released;
+	}
+};
+
+template<typename T>
+object_pool<T>& get_object_pool() {
+	static object_pool<T> pool;
+	return pool;
+}
+
+template<typename T>
+struct pool_deleter {
+	void operator()(T* pointer) const {
+		pointer->~T();
+		get_object_pool<T>().deallocate(pointer);
+	}
+};
+
+template<typename T>
+using pool_ptr = std::unique_ptr<T, pool_deleter<T>>;
+
+template<typename T, typename... Args>
+pool_ptr<T> make_pooled(Args&&... args) {
+	auto memory = get_object_pool<T>().allocate();
+	try {
+		return pool_ptr<T>(new (memory) T(std::forward<Args>(args)...));
+	}
+	catch (...) {
+		get_object_pool<T>().deallocate(memory);
+		throw;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <filesystem>
+#include <string>
+
+//absolute, lexically normalized and without a trailing slash, so paths can be compared as strings
+inline std::string normalize_path(const std::string& path) {
+	std::error_code error;
+	auto absolute = std::filesystem::absolute(path, error);
+	auto result = (error ? std::filesystem::path(path) : absolute).lexically_normal().generic_string();
+	while (result.size() > 1u && result.back() == '/') {
+		result.pop_back();
+	}
+	return result;
+}
+
+//a normalized path overlaps itself and everything inside or above it
+inline bool paths_overlap(const std::string& a, const std::string& b) {
+	auto& shorter = a.size() < b.size() ? a : b;
+	auto& longer = a.size() < b.size() ? b : a;
+	if (shorter.empty() || !longer.starts_with(shorter)) {
+		return shorter.empty() && longer.empty();
+	}
+	return longer.size() == shorter.size() || longer[shorter.size()] == '/' || shorter.back() == '/';
+}
+//true if path is root or inside it
+inline bool path_contains(const std::string& root, const std::string& path) {
+	return path.size() >= root.size() && paths_overlap(root, path);
+}
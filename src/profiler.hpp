@@ -0,0 +1,221 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include "config.hpp"
+
+enum class profile_section : qpl::u8 {
+	frame,
+	widgets_update,
+	hit_test,
+	draw,
+	text_layout,
+	script,
+	save_load,
+	count,
+};
+enum class profile_counter : qpl::u8 {
+	widgets_drawn,
+	widgets_culled,
+	draw_calls,
+	allocations,
+	texture_renders,
+	count,
+};
+
+constexpr std::array<const char*, qpl::size(profile_section::count)> profile_section_names = {
+	"frame", "widgets update", "hit test", "draw", "text layout", "script", "save/load"
+};
+constexpr std::array<const char*, qpl::size(profile_counter::count)> profile_counter_names = {
+	"widgets drawn", "widgets culled", "draw calls", "allocations", "texture renders"
+};
+
+//counted by the global operator new in main.cpp
+inline std::atomic<qpl::u64> allocation_count = 0u;
+
+//per frame timings and counters with a rolling history. recording is a couple of clock reads and
+//relaxed atomic adds, so it stays on in every build; sections can be recorded from any thread
+struct profiler {
+	constexpr static qpl::size sections = qpl::size(profile_section::count);
+	constexpr static qpl::size counters = qpl::size(profile_counter::count);
+
+	struct frame {
+		std::array<qpl::u64, sections> nanoseconds{};
+		std::array<qpl::u64, counters> counts{};
+	};
+
+	std::array<std::atomic<qpl::u64>, sections> current_nanoseconds{};
+	std::array<std::atomic<qpl::u64>, counters> current_counts{};
+	std::vector<frame> history = std::vector<frame>(config::profiler_history);
+	qpl::size history_index = 0u;
+	qpl::size history_size = 0u;
+	qpl::u64 frame_start = 0u;
+	qpl::u64 allocations_start = 0u;
+
+	static qpl::u64 now() {
+		return static_cast<qpl::u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void add(profile_section section, qpl::u64 nanoseconds) {
+		this->current_nanoseconds[qpl::size(section)].fetch_add(nanoseconds, std::memory_order_relaxed);
+	}
+	void count(profile_counter counter, qpl::u64 amount = 1u) {
+		this->current_counts[qpl::size(counter)].fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	//closes the previous frame and opens the next one, called once at the start of every update
+	void next_frame() {
+		auto time = now();
+		auto allocations = allocation_count.load(std::memory_order_relaxed);
+		if (this->frame_start) {
+			this->add(profile_section::frame, time - this->frame_start);
+			this->count(profile_counter::allocations, allocations - this->allocations_start);
+			this->store_frame();
+		}
+		this->frame_start = time;
+		this->allocations_start = allocations;
+	}
+	void store_frame() {
+
+		auto& frame = this->history[this->history_index];
+		for (qpl::size i = 0u; i < sections; ++i) {
+			frame.nanoseconds[i] = this->current_nanoseconds[i].exchange(0u, std::memory_order_relaxed);
+		}
+		for (qpl::size i = 0u; i < counters; ++i) {
+			frame.counts[i] = this->current_counts[i].exchange(0u, std::memory_order_relaxed);
+		}
+		this->history_index = (this->history_index + 1) % this->history.size();
+		this->history_size = std::min(this->history_size + 1, this->history.size());
+	}
+
+	//oldest to newest
+	template<typename F>
+	void for_each_frame(F&& function) const {
+		auto begin = (this->history_index + this->history.size() - this->history_size) % this->history.size();
+		for (qpl::size i = 0u; i < this->history_size; ++i) {
+			function(this->history[(begin + i) % this->history.size()]);
+		}
+	}
+	//percentile of a section over the history in milliseconds
+	qpl::f64 percentile(profile_section section, qpl::f64 fraction) const {
+		if (!this->history_size) {
+			return 0.0;
+		}
+		std::vector<qpl::u64> values;
+		values.reserve(this->history_size);
+		this->for_each_frame([&](const frame& frame) {
+			values.push_back(frame.nanoseconds[qpl::size(section)]);
+		});
+		auto index = std::min(values.size() - 1, static_cast<qpl::size>(fraction * values.size()));
+		std::ranges::nth_element(values, values.begin() + index);
+		return values[index] / 1e6;
+	}
+	const frame& last_frame() const {
+		return this->history[(this->history_index + this->history.size() - 1) % this->history.size()];
+	}
+
+	std::string summary() const {
+		std::string result;
+		result += qpl::to_string("profiler (", this->history_size, " frames)      p50 ms    p99 ms   last ms\n");
+		for (qpl::size i = 0u; i < sections; ++i) {
+			auto section = profile_section(i);
+			result += qpl::to_string(
+				qpl::str_lspaced(profile_section_names[i], 16),
+				qpl::str_rspaced(qpl::to_string_precision(3, this->percentile(section, 0.5)), 10),
+				qpl::str_rspaced(qpl::to_string_precision(3, this->percentile(section, 0.99)), 10),
+				qpl::str_rspaced(qpl::to_string_precision(3, this->last_frame().nanoseconds[i] / 1e6), 10), '\n'
+			);
+		}
+		for (qpl::size i = 0u; i < counters; ++i) {
+			result += qpl::to_string(qpl::str_lspaced(profile_counter_names[i], 16), qpl::str_rspaced(this->last_frame().counts[i], 10), '\n');
+		}
+		return result;
+	}
+
+	bool export_csv(const std::string& path) const {
+		std::ofstream file(path);
+		if (!file) {
+			return false;
+		}
+		for (qpl::size i = 0u; i < sections; ++i) {
+			file << profile_section_names[i] << " ms,";
+		}
+		for (qpl::size i = 0u; i < counters; ++i) {
+			file << profile_counter_names[i] << (i + 1 == counters ? "\n" : ",");
+		}
+		this->for_each_frame([&](const frame& frame) {
+			for (qpl::size i = 0u; i < sections; ++i) {
+				file << frame.nanoseconds[i] / 1e6 << ',';
+			}
+			for (qpl::size i = 0u; i < counters; ++i) {
+				file << frame.counts[i] << (i + 1 == counters ? "\n" : ",");
+			}
+		});
+		return static_cast<bool>(file);
+	}
+};
+
+inline profiler& get_profiler() {
+	static profiler profiler;
+	return profiler;
+}
+
+//adds the time until it goes out of scope to a section
+struct profile_scope {
+	profile_section section;
+	qpl::u64 start;
+
+	profile_scope(profile_section section) : section(section), start(profiler::now()) {
+
+	}
+	~profile_scope() {
+		get_profiler().add(this->section, profiler::now() - this->start);
+	}
+	profile_scope(const profile_scope&) = delete;
+	profile_scope& operator=(const profile_scope&) = delete;
+};
+
+//on screen table of the profiler, refreshed a few times per second
+struct profiler_overlay {
+	qsf::text text;
+	qsf::rectangle background;
+	bool visible = false;
+	qpl::size frames_since_refresh = 0u;
+
+	profiler_overlay() {
+		this->text.set_font("consola");
+		this->text.set_character_size(16);
+		this->text.set_color(qpl::rgb::white());
+		this->text.set_position(qpl::vec(20, 20));
+		this->background.set_color(qpl::rgb(0, 0, 0, 200));
+	}
+
+	void update(const qsf::event_info& event) {
+		if (event.key_single_pressed(sf::Keyboard::F3)) {
+			this->visible = !this->visible;
+			this->frames_since_refresh = config::profiler_refresh_frames;
+		}
+		if (event.key_single_pressed(sf::Keyboard::F4)) {
+			auto path = qpl::to_string(config::profiler_csv_path);
+			if (get_profiler().export_csv(path)) {
+				qpl::println("profiler: wrote ", path);
+			}
+			else {
+				qpl::println("profiler: couldn't write ", path);
+			}
+		}
+		if (this->visible && ++this->frames_since_refresh >= config::profiler_refresh_frames) {
+			this->frames_since_refresh = 0u;
+			this->text.set_string(get_profiler().summary());
+			this->background.set_hitbox(this->text.get_visible_hitbox().increased(10));
+		}
+	}
+	void draw(qsf::draw_object& draw) const {
+		if (this->visible) {
+			draw.draw(this->background);
+			draw.draw(this->text);
+		}
+	}
+};
@@ -0,0 +1,481 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <charconv>
+#include "copy_engine.hpp"
+#include "sync.hpp"
+#include "utf8.hpp"
+#include "profiler.hpp"
+#include "config.hpp"
+
+enum class script_opcode : qpl::u8 {
+	copy,
+	move,
+	remove,
+	rename,
+	sync,
+	assign,
+	ignored,
+};
+
+//an argument is a sequence of literal text and variable slots, e.g. "$root$/bin" -> [slot 0]["/bin"]
+struct script_argument {
+	struct segment {
+		std::string literal;
+		qpl::size variable = qpl::size_max;
+	};
+	std::vector<segment> segments;
+
+	std::string resolve(const std::vector<std::string>& variables) const {
+		if (this->segments.size() == 1u && this->segments[0].variable == qpl::size_max) {
+			return this->segments[0].literal;
+		}
+		std::string result;
+		for (auto& i : this->segments) {
+			if (i.variable == qpl::size_max) {
+				result += i.literal;
+			}
+			else {
+				result += variables[i.variable];
+			}
+		}
+		return result;
+	}
+};
+
+namespace script_flags {
+	constexpr qpl::u8 hash = 1u << 0;
+	constexpr qpl::u8 dry_run = 1u << 1;
+	constexpr qpl::u8 fast = 1u << 2;
+}
+
+struct script_instruction {
+	script_opcode opcode = script_opcode::ignored;
+	qpl::size line = 0u;
+	qpl::size variable = qpl::size_max;
+	qpl::u8 flags = 0u;
+	std::vector<script_argument> arguments;
+};
+
+struct script_error {
+	qpl::size line = 0u;
+	std::string message;
+
+	std::string string() const {
+		return qpl::to_string("line ", this->line + 1, ": ", this->message);
+	}
+};
+
+struct compiled_script {
+	std::vector<script_instruction> instructions;
+	std::vector<std::string> variable_names;
+	std::vector<script_error> errors;
+	qpl::size line_count = 0u;
+	bool watch = false;
+	qpl::f64 watch_debounce = config::script_watch_debounce;
+
+	bool has_errors() const {
+		return !this->errors.empty();
+	}
+};
+
+struct script_compiler {
+	compiled_script result;
+	std::unordered_map<std::string, qpl::size> variable_slots;
+	qpl::size line = 0u;
+
+	qpl::size get_variable_slot(const std::string& name) {
+		auto it = this->variable_slots.find(name);
+		if (it != this->variable_slots.cend()) {
+			return it->second;
+		}
+		auto slot = this->result.variable_names.size();
+		this->variable_slots[name] = slot;
+		this->result.variable_names.push_back(name);
+		return slot;
+	}
+	void add_error(std::string message) {
+		this->result.errors.push_back({ this->line, std::move(message) });
+	}
+
+	//only $name$ is a variable, a lone $ (e.g. in a windows share path) stays literal text like it always did
+	script_argument compile_argument(const std::string& word, bool allow_variables = true) {
+		script_argument argument;
+		if (!allow_variables) {
+			argument.segments.push_back({ word });
+			return argument;
+		}
+
+		qpl::size begin = qpl::size_max;
+		qpl::size end = 0u;
+		for (qpl::size i = 0u; i < word.length(); ++i) {
+			if (word[i] == '$') {
+				if (begin == qpl::size_max) {
+					if (i != end) {
+						argument.segments.push_back({ word.substr(end, i - end) });
+					}
+					begin = i + 1;
+				}
+				else {
+					argument.segments.push_back({ "", this->get_variable_slot(word.substr(begin, i - begin)) });
+					end = i + 1;
+					begin = qpl::size_max;
+				}
+			}
+		}
+		if (begin != qpl::size_max) {
+			end = begin - 1;
+		}
+		if (end < word.length() || argument.segments.empty()) {
+			argument.segments.push_back({ word.substr(end) });
+		}
+		return argument;
+	}
+
+	void compile_command(script_opcode opcode, const std::vector<std::string>& words, qpl::size argument_count, const std::string& name, bool allow_variables = true) {
+		if (words.size() != argument_count + 1) {
+			this->add_error(qpl::to_string(name, ": invalid number of arguments."));
+			return;
+		}
+		script_instruction instruction;
+		instruction.opcode = opcode;
+		instruction.line = this->line;
+		for (qpl::size i = 1u; i < words.size(); ++i) {
+			instruction.arguments.push_back(this->compile_argument(words[i], allow_variables));
+		}
+		this->result.instructions.push_back(std::move(instruction));
+	}
+
+	//sync <a> <b> [hash] [dry] [fast]
+	void compile_sync(std::vector<std::string> words) {
+		qpl::u8 flags = 0u;
+		while (words.size() > 3u) {
+			auto& flag = words.back();
+			if (qpl::string_equals_ignore_case(flag, "hash")) {
+				flags |= script_flags::hash;
+			}
+			else if (qpl::string_equals_ignore_case(flag, "dry")) {
+				flags |= script_flags::dry_run;
+			}
+			else if (qpl::string_equals_ignore_case(flag, "fast")) {
+				flags |= script_flags::fast;
+			}
+			else {
+				this->add_error(qpl::to_string("sync: unknown option \"", flag, "\"."));
+				return;
+			}
+			words.pop_back();
+		}
+		this->compile_command(script_opcode::sync, words, 2u, "sync");
+		if (words.size() == 3u) {
+			this->result.instructions.back().flags = flags;
+		}
+	}
+
+	//watch [debounce in ms]
+	void compile_watch(const std::vector<std::string>& words) {
+		if (words.size() > 2u) {
+			this->add_error("watch: invalid number of arguments.");
+			return;
+		}
+		if (words.size() == 2u) {
+			qpl::u64 milliseconds = 0u;
+			auto [end, error] = std::from_chars(words[1].data(), words[1].data() + words[1].size(), milliseconds);
+			if (error != std::errc{} || end != words[1].data() + words[1].size()) {
+				this->add_error(qpl::to_string("watch: \"", words[1], "\" isn't a debounce time in milliseconds."));
+				return;
+			}
+			this->result.watch_debounce = milliseconds / 1000.0;
+		}
+		this->result.watch = true;
+	}
+
+	void compile_line(const std::string& line) {
+		auto words = qpl::string_split(line);
+		if (words.empty() || words[0].empty()) {
+			return;
+		}
+		auto& command = words[0];
+
+		if (qpl::string_equals_ignore_case(command, "copy")) {
+			this->compile_command(script_opcode::copy, words, 2u, "copy");
+		}
+		else if (qpl::string_equals_ignore_case(command, "move")) {
+			this->compile_command(script_opcode::move, words, 2u, "move");
+		}
+		else if (qpl::string_equals_ignore_case(command, "remove")) {
+			this->compile_command(script_opcode::remove, words, 1u, "remove");
+		}
+		else if (qpl::string_equals_ignore_case(command, "rename")) {
+			this->compile_command(script_opcode::rename, words, 2u, "rename", false);
+		}
+		else if (qpl::string_equals_ignore_case(command, "sync")) {
+			this->compile_sync(words);
+		}
+		else if (qpl::string_equals_ignore_case(command, "watch")) {
+			this->compile_watch(words);
+		}
+		else if (command[0] == '$' && qpl::count(command, '$') == 1u) {
+			script_instruction instruction;
+			instruction.opcode = script_opcode::assign;
+			instruction.line = this->line;
+			for (qpl::size i = 1u; i < words.size(); ++i) {
+				bool equals_sign = (words[i] == "=" || words[i] == ":");
+				if (!equals_sign) {
+					instruction.arguments.push_back(this->compile_argument(words[i]));
+					break;
+				}
+			}
+			if (instruction.arguments.empty()) {
+				this->add_error(qpl::to_string("variable \"", command.substr(1u), "\" has no value."));
+				return;
+			}
+			instruction.variable = this->get_variable_slot(command.substr(1u));
+			this->result.instructions.push_back(std::move(instruction));
+		}
+		else {
+			script_instruction instruction;
+			instruction.opcode = script_opcode::ignored;
+			instruction.line = this->line;
+			for (auto& word : words) {
+				instruction.arguments.push_back(this->compile_argument(word));
+			}
+			this->result.instructions.push_back(std::move(instruction));
+		}
+	}
+
+	//reads the lines straight from the rope. empty lines emit no instruction but still count,
+	//so errors and instructions carry their line in the widget text
+	compiled_script compile(const text_rope& text) {
+		this->result = compiled_script{};
+		this->variable_slots.clear();
+
+		this->line = 0u;
+		text.for_each_line([&](const std::wstring& line) {
+			if (!line.empty()) {
+				this->compile_line(utf8::encode(line));
+			}
+			++this->line;
+		});
+		this->result.line_count = this->line;
+		return std::move(this->result);
+	}
+};
+
+inline std::shared_ptr<const compiled_script> compile_script(const text_rope& text) {
+	script_compiler compiler;
+	return std::make_shared<const compiled_script>(compiler.compile(text));
+}
+
+enum class script_state {
+	idle,
+	queued,
+	running,
+	done,
+	failed,
+	cancelled,
+};
+
+struct script_job {
+	std::shared_ptr<const compiled_script> script;
+	std::atomic<script_state> state = script_state::queued;
+	std::atomic<qpl::size> line = 0u;
+	std::atomic<qpl::size> line_count = 0u;
+	std::atomic<qpl::size> error_count = 0u;
+	std::atomic_bool cancel_requested = false;
+	copy_statistics statistics;
+
+	//jobs of a pipeline share the statistics, errors and cancellation of their script's job
+	std::shared_ptr<script_job> parent;
+	//called on the worker thread once the final state is set
+	std::function<void(script_job&)> on_finished;
+
+	mutable std::mutex mutex;
+	std::string error;
+
+	std::atomic_bool& get_cancel_flag() {
+		return this->parent ? this->parent->cancel_requested : this->cancel_requested;
+	}
+	copy_statistics& get_statistics() {
+		return this->parent ? this->parent->statistics : this->statistics;
+	}
+	void cancel() {
+		this->get_cancel_flag() = true;
+	}
+	bool is_cancelled() const {
+		return this->parent ? this->parent->is_cancelled() : this->cancel_requested.load();
+	}
+	bool is_finished() const {
+		auto state = this->state.load();
+		return state == script_state::done || state == script_state::failed || state == script_state::cancelled;
+	}
+	qpl::f64 get_progress() const {
+		auto count = this->line_count.load();
+		if (!count) {
+			return 0.0;
+		}
+		return static_cast<qpl::f64>(this->line.load()) / count;
+	}
+	void add_error(const std::string& message) {
+		std::lock_guard lock(this->mutex);
+		if (!this->error.empty()) {
+			this->error += '\n';
+		}
+		this->error += message;
+		++this->error_count;
+		if (this->parent) {
+			this->parent->add_error(message);
+		}
+	}
+	std::string get_error() const {
+		std::lock_guard lock(this->mutex);
+		return this->error;
+	}
+};
+
+//interprets the compiled instructions, checks for cancellation between instructions
+inline void execute_script(script_job& job) {
+	profile_scope scope(profile_section::script);
+	auto& script = *job.script;
+	job.line_count = script.instructions.size();
+	for (auto& error : script.errors) {
+		qpl::println(error.string());
+		job.add_error(error.string());
+	}
+
+	std::vector<std::string> variables(script.variable_names.size());
+	auto& statistics = job.get_statistics();
+	if (!job.parent) {
+		statistics.start();
+	}
+
+	auto copy = [&](const std::string& source, const std::string& destination, bool move) {
+		copy_engine engine(&statistics, &job.get_cancel_flag());
+		if (move) {
+			engine.move(source, destination);
+		}
+		else {
+			engine.copy(source, destination);
+		}
+		for (auto& error : engine.errors) {
+			qpl::println(qpl::foreground::red, error);
+			job.add_error(error);
+		}
+		qpl::println(statistics.string());
+	};
+
+	for (qpl::size i = 0u; i < script.instructions.size(); ++i) {
+		if (job.is_cancelled()) {
+			return;
+		}
+		job.line = i;
+
+		auto& instruction = script.instructions[i];
+		auto argument = [&](qpl::size index) {
+			return instruction.arguments[index].resolve(variables);
+		};
+
+		switch (instruction.opcode) {
+		case script_opcode::copy: {
+			auto src = argument(0u);
+			auto dest = argument(1u);
+
+			qpl::println("copy ", qpl::foreground::aqua, src, "to ", qpl::foreground::aqua, dest);
+			copy(src, dest, false);
+		} break;
+		case script_opcode::move: {
+			auto src = argument(0u);
+			auto dest = argument(1u);
+
+			qpl::println("move ", qpl::foreground::aqua, src, "to ", qpl::foreground::aqua, dest);
+			copy(src, dest, true);
+		} break;
+		case script_opcode::remove: {
+			auto src = argument(0u);
+			qpl::println("remove ", qpl::foreground::aqua, src);
+			qpl::filesys::remove(src);
+		} break;
+		case script_opcode::rename: {
+			auto src = argument(0u);
+			auto dest = argument(1u);
+			qpl::println("rename ", qpl::foreground::aqua, src, " to ", qpl::foreground::aqua, dest);
+			qpl::filesys::rename(src, dest);
+		} break;
+		case script_opcode::sync: {
+			auto src_string = argument(0u);
+			auto dest_string = argument(1u);
+			qpl::filesys::path src = src_string;
+			qpl::filesys::path dest = dest_string;
+
+			std::error_code error;
+			bool directories = std::filesystem::is_directory(src_string, error) || std::filesystem::is_directory(dest_string, error);
+
+			if (directories) {
+				synchronizer sync;
+				sync.a = src_string;
+				sync.b = dest_string;
+				sync.options.hash = instruction.flags & script_flags::hash;
+				sync.options.dry_run = instruction.flags & script_flags::dry_run;
+				sync.options.fast = instruction.flags & script_flags::fast;
+				sync.statistics = &statistics;
+				sync.cancel = &job.get_cancel_flag();
+				qpl::println("sync ", qpl::foreground::aqua, src_string, " with ", qpl::foreground::aqua, dest_string);
+				sync.run();
+				for (auto& error : sync.errors) {
+					qpl::println(qpl::foreground::red, error);
+					job.add_error(error);
+				}
+			}
+			else if (!src.exists() && !dest.exists()) {
+				qpl::println("sync: both paths don't exist.");
+				job.add_error("sync: both paths don't exist.");
+			}
+			else if (!src.exists()) {
+				src.create();
+				qpl::println("sync ", qpl::foreground::aqua, dest, " to ", qpl::foreground::aqua, src);
+				copy(dest_string, src_string, false);
+			}
+			else if (!dest.exists()) {
+				dest.create();
+				qpl::println("sync ", qpl::foreground::aqua, src, " to ", qpl::foreground::aqua, dest);
+				copy(src_string, dest_string, false);
+			}
+			else {
+				auto a_time = src.last_write_time();
+				auto b_time = dest.last_write_time();
+
+				if (a_time < b_time) {
+					qpl::println("sync ", qpl::foreground::aqua, dest, " to ", qpl::foreground::aqua, src);
+					copy(dest_string, src_string, false);
+				}
+				else if (b_time < a_time) {
+					qpl::println("sync ", qpl::foreground::aqua, src, " to ", qpl::foreground::aqua, dest);
+					copy(src_string, dest_string, false);
+				}
+				else {
+					qpl::println(qpl::foreground::aqua, src, " and ", qpl::foreground::aqua, dest, " are synchronized already.");
+				}
+			}
+		} break;
+		case script_opcode::assign: {
+			auto value = argument(0u);
+			if (!value.empty()) {
+				variables[instruction.variable] = value;
+			}
+		} break;
+		case script_opcode::ignored: {
+			qpl::print("ignored command: \"");
+			for (qpl::size a = 0u; a < instruction.arguments.size(); ++a) {
+				if (a) {
+					qpl::print(' ');
+				}
+				qpl::print(argument(a));
+			}
+			qpl::println("\"");
+		} break;
+		}
+	}
+	job.line = script.instructions.size();
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include "script.hpp"
+#include "config.hpp"
+
+//runs executable scripts on a fixed pool of worker threads so the frame loop never blocks on file io
+struct script_executor {
+	std::vector<std::thread> workers;
+	std::deque<std::shared_ptr<script_job>> queue;
+	std::vector<std::weak_ptr<script_job>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	script_executor(qpl::size worker_count = config::script_worker_count) {
+		worker_count = std::max(worker_count, qpl::size{ 1u });
+		for (qpl::size i = 0u; i < worker_count; ++i) {
+			this->workers.emplace_back([this]() {
+				this->work();
+			});
+		}
+	}
+	~script_executor() {
+		{
+			std::lock_guard lock(this->mutex);
+			this->stopping = true;
+			for (auto& i : this->jobs) {
+				if (auto job = i.lock()) {
+					job->cancel();
+				}
+			}
+		}
+		this->condition.notify_all();
+		for (auto& i : this->workers) {
+			i.join();
+		}
+	}
+	script_executor(const script_executor&) = delete;
+	script_executor& operator=(const script_executor&) = delete;
+
+	std::shared_ptr<script_job> submit(std::shared_ptr<const compiled_script> script) {
+		auto job = std::make_shared<script_job>();
+		job->script = std::move(script);
+		return this->submit(std::move(job));
+	}
+	std::shared_ptr<script_job> submit(std::shared_ptr<script_job> job) {
+		{
+			std::lock_guard lock(this->mutex);
+			if (this->stopping) {
+				job->cancel();
+			}
+			std::erase_if(this->jobs, [](const std::weak_ptr<script_job>& job) {
+				return job.expired();
+			});
+			this->jobs.push_back(job);
+			this->queue.push_back(job);
+		}
+		this->condition.notify_one();
+		return job;
+	}
+
+	qpl::size worker_count() const {
+		return this->workers.size();
+	}
+
+private:
+	void work() {
+		while (true) {
+			std::shared_ptr<script_job> job;
+			{
+				std::unique_lock lock(this->mutex);
+				this->condition.wait(lock, [&]() {
+					return this->stopping || !this->queue.empty();
+				});
+				if (this->queue.empty()) {
+					return;
+				}
+				job = std::move(this->queue.front());
+				this->queue.pop_front();
+			}
+			if (job->is_cancelled()) {
+				job->state = script_state::cancelled;
+				this->finish(*job);
+				continue;
+			}
+
+			job->state = script_state::running;
+			try {
+				execute_script(*job);
+			}
+			catch (std::exception& any) {
+				qpl::println("script failed: ", any.what());
+				job->add_error(any.what());
+			}
+
+			if (job->is_cancelled()) {
+				job->state = script_state::cancelled;
+			}
+			else if (job->error_count) {
+				job->state = script_state::failed;
+			}
+			else {
+				job->state = script_state::done;
+			}
+			this->finish(*job);
+		}
+	}
+	void finish(script_job& job) {
+		if (job.on_finished) {
+			try {
+				job.on_finished(job);
+			}
+			catch (std::exception& any) {
+				qpl::println("script callback failed: ", any.what());
+			}
+		}
+	}
+};
+
+inline script_executor& get_script_executor() {
+	static script_executor executor;
+	return executor;
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <filesystem>
+#include "script_executor.hpp"
+#include "paths.hpp"
+
+//one file operation of a pipeline, its arguments are resolved to literal paths up front
+struct pipeline_operation {
+	std::shared_ptr<const compiled_script> script;
+	qpl::size script_index = 0u;
+	qpl::size line = 0u;
+	std::vector<std::string> reads;
+	std::vector<std::string> writes;
+	//paths whose changes should re-run the operation in watch mode
+	std::vector<std::string> sources;
+	std::vector<qpl::size> dependents;
+	qpl::size dependencies = 0u;
+	bool skipped = false;
+};
+
+//runs several scripts as one pipeline: every copy/move/sync/remove/rename becomes a node, operations whose
+//paths overlap keep their order (script order, then line order) and everything else runs in parallel.
+//each script keeps one job for its widget, the operation jobs report their progress, errors and
+//cancellation through it. operations that depend on a failed or cancelled one are skipped.
+struct script_pipeline : std::enable_shared_from_this<script_pipeline> {
+	std::vector<std::shared_ptr<script_job>> jobs;
+	std::vector<pipeline_operation> operations;
+	std::vector<qpl::size> remaining;
+	std::mutex mutex;
+
+	static bool overlaps(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+		for (auto& i : a) {
+			for (auto& j : b) {
+				if (paths_overlap(i, j)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	static bool conflicts(const pipeline_operation& a, const pipeline_operation& b) {
+		return overlaps(a.writes, b.writes) || overlaps(a.writes, b.reads) || overlaps(a.reads, b.writes);
+	}
+
+	//assignments are evaluated here, so every operation only carries literal arguments.
+	//with changed paths only the operations reading from them and everything ordered after those is kept
+	void add_script(const compiled_script& script, const std::vector<std::string>& changed = {}) {
+		auto script_index = this->jobs.size();
+		auto job = std::make_shared<script_job>();
+		for (auto& error : script.errors) {
+			job->add_error(error.string());
+		}
+		this->jobs.push_back(job);
+		this->remaining.push_back(0u);
+
+		std::vector<pipeline_operation> operations;
+		std::vector<std::string> variables(script.variable_names.size());
+		for (auto& instruction : script.instructions) {
+			auto argument = [&](qpl::size index) {
+				return instruction.arguments[index].resolve(variables);
+			};
+			if (instruction.opcode == script_opcode::assign) {
+				auto value = argument(0u);
+				if (!value.empty()) {
+					variables[instruction.variable] = value;
+				}
+				continue;
+			}
+			if (instruction.opcode == script_opcode::ignored) {
+				continue;
+			}
+
+			pipeline_operation operation;
+			operation.script_index = script_index;
+			operation.line = instruction.line;
+
+			auto resolved = std::make_shared<compiled_script>();
+			auto& copy = resolved->instructions.emplace_back();
+			copy.opcode = instruction.opcode;
+			copy.line = instruction.line;
+			copy.flags = instruction.flags;
+			for (qpl::size i = 0u; i < instruction.arguments.size(); ++i) {
+				copy.arguments.emplace_back().segments.push_back({ argument(i) });
+			}
+			resolved->line_count = 1u;
+			operation.script = std::move(resolved);
+
+			switch (instruction.opcode) {
+			case script_opcode::copy:
+				operation.reads.push_back(normalize_path(argument(0u)));
+				operation.writes.push_back(normalize_path(argument(1u)));
+				operation.sources = operation.reads;
+				break;
+			case script_opcode::move:
+				operation.writes.push_back(normalize_path(argument(0u)));
+				operation.writes.push_back(normalize_path(argument(1u)));
+				operation.sources.push_back(operation.writes[0]);
+				break;
+			case script_opcode::sync:
+				operation.writes.push_back(normalize_path(argument(0u)));
+				operation.writes.push_back(normalize_path(argument(1u)));
+				operation.sources = operation.writes;
+				break;
+			case script_opcode::remove:
+				operation.writes.push_back(normalize_path(argument(0u)));
+				break;
+			case script_opcode::rename: {
+				auto source = normalize_path(argument(0u));
+				operation.writes.push_back(source);
+				operation.writes.push_back(normalize_path((std::filesystem::path(source).parent_path() / argument(1u)).generic_string()));
+			} break;
+			default:
+				break;
+			}
+			operations.push_back(std::move(operation));
+		}
+
+		std::vector<bool> affected(operations.size(), changed.empty());
+		for (qpl::size i = 0u; i < operations.size() && !changed.empty(); ++i) {
+			affected[i] = overlaps(operations[i].sources, changed);
+			for (qpl::size j = 0u; j < i && !affected[i]; ++j) {
+				affected[i] = affected[j] && conflicts(operations[j], operations[i]);
+			}
+		}
+		for (qpl::size i = 0u; i < operations.size(); ++i) {
+			if (affected[i]) {
+				this->operations.push_back(std::move(operations[i]));
+				++this->remaining[script_index];
+			}
+		}
+		job->line_count = this->remaining[script_index];
+	}
+
+	void build_graph() {
+		for (qpl::size i = 0u; i < this->operations.size(); ++i) {
+			for (qpl::size j = i + 1; j < this->operations.size(); ++j) {
+				if (conflicts(this->operations[i], this->operations[j])) {
+					this->operations[i].dependents.push_back(j);
+					++this->operations[j].dependencies;
+				}
+			}
+		}
+	}
+
+	void start() {
+		this->build_graph();
+		for (qpl::size i = 0u; i < this->jobs.size(); ++i) {
+			this->jobs[i]->statistics.start();
+			if (!this->remaining[i]) {
+				this->finish_script(i);
+			}
+		}
+		std::vector<qpl::size> ready;
+		for (qpl::size i = 0u; i < this->operations.size(); ++i) {
+			if (!this->operations[i].dependencies) {
+				ready.push_back(i);
+			}
+		}
+		this->dispatch(std::move(ready));
+	}
+	void cancel() {
+		for (auto& job : this->jobs) {
+			job->cancel();
+		}
+	}
+	bool is_finished() const {
+		return std::ranges::all_of(this->jobs, [](const std::shared_ptr<script_job>& job) {
+			return job->is_finished();
+		});
+	}
+
+private:
+	void finish_script(qpl::size index) {
+		auto& job = *this->jobs[index];
+		if (job.is_cancelled()) {
+			job.state = script_state::cancelled;
+		}
+		else if (job.error_count) {
+			job.state = script_state::failed;
+		}
+		else {
+			job.state = script_state::done;
+		}
+	}
+
+	//operations that can't run are finished right away, which might make more operations ready
+	void dispatch(std::vector<qpl::size> ready) {
+		std::weak_ptr<script_pipeline> self = this->shared_from_this();
+		while (!ready.empty()) {
+			auto index = ready.back();
+			ready.pop_back();
+
+			auto& operation = this->operations[index];
+			auto& parent = this->jobs[operation.script_index];
+			if (operation.skipped || parent->is_cancelled()) {
+				if (!parent->is_cancelled()) {
+					parent->add_error(qpl::to_string("line ", operation.line + 1, ": skipped, an operation it depends on failed."));
+				}
+				this->finish(index, false, ready);
+				continue;
+			}
+
+			auto job = std::make_shared<script_job>();
+			job->script = operation.script;
+			job->parent = parent;
+			job->on_finished = [self, index](script_job& job) {
+				if (auto pipeline = self.lock()) {
+					std::vector<qpl::size> ready;
+					pipeline->finish(index, job.state == script_state::done, ready);
+					pipeline->dispatch(std::move(ready));
+				}
+			};
+			auto expected = script_state::queued;
+			parent->state.compare_exchange_strong(expected, script_state::running);
+			get_script_executor().submit(std::move(job));
+		}
+	}
+	void finish(qpl::size index, bool success, std::vector<qpl::size>& ready) {
+		std::lock_guard lock(this->mutex);
+		auto& operation = this->operations[index];
+		auto& parent = *this->jobs[operation.script_index];
+		++parent.line;
+		if (--this->remaining[operation.script_index] == 0u) {
+			this->finish_script(operation.script_index);
+		}
+		for (auto& dependent : operation.dependents) {
+			if (!success) {
+				this->operations[dependent].skipped = true;
+			}
+			if (--this->operations[dependent].dependencies == 0u) {
+				ready.push_back(dependent);
+			}
+		}
+	}
+};
+
+//scripts are given in pipeline order
+inline std::shared_ptr<script_pipeline> run_pipeline(const std::vector<std::shared_ptr<const compiled_script>>& scripts) {
+	auto pipeline = std::make_shared<script_pipeline>();
+	for (auto& script : scripts) {
+		pipeline->add_script(*script);
+	}
+	pipeline->start();
+	return pipeline;
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <condition_variable>
+#include "file_watcher.hpp"
+#include "script_pipeline.hpp"
+
+//watch mode of one script: changes below its source paths are collected until nothing happened for the
+//debounce time, then only the lines reading from the changed paths (and the lines ordered after them) run.
+//changes to paths the running job writes to are its own and ignored.
+struct script_watch {
+	std::shared_ptr<const compiled_script> script;
+	std::vector<std::string> sources;
+	std::vector<qpl::size> subscriptions;
+
+	std::mutex mutex;
+	std::vector<std::string> changed;
+	std::chrono::steady_clock::time_point deadline;
+	std::shared_ptr<script_pipeline> pipeline;
+	std::shared_ptr<script_job> job;
+	std::atomic_bool job_started = false;
+
+	~script_watch() {
+		for (auto& id : this->subscriptions) {
+			get_file_watcher().remove(id);
+		}
+	}
+
+	static std::vector<std::string> get_sources(const compiled_script& script) {
+		script_pipeline pipeline;
+		pipeline.add_script(script);
+		std::vector<std::string> result;
+		for (auto& operation : pipeline.operations) {
+			for (auto& source : operation.sources) {
+				if (std::ranges::find(result, source) == result.cend()) {
+					result.push_back(source);
+				}
+			}
+		}
+		return result;
+	}
+
+	bool is_running() const {
+		return this->pipeline && !this->pipeline->is_finished();
+	}
+	bool is_pending() {
+		std::lock_guard lock(this->mutex);
+		return !this->changed.empty();
+	}
+	void add_change(const std::string& path) {
+		std::lock_guard lock(this->mutex);
+		if (this->is_running()) {
+			for (auto& operation : this->pipeline->operations) {
+				for (auto& write : operation.writes) {
+					if (path_contains(write, path)) {
+						return;
+					}
+				}
+			}
+		}
+		if (std::ranges::find(this->changed, path) == this->changed.cend()) {
+			this->changed.push_back(path);
+		}
+		this->deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<qpl::f64>(this->script->watch_debounce));
+	}
+	//the ui thread picks up jobs started by the watcher through this
+	std::shared_ptr<script_job> take_job() {
+		if (!this->job_started.exchange(false)) {
+			return nullptr;
+		}
+		std::lock_guard lock(this->mutex);
+		return this->job;
+	}
+};
+
+//one thread that sleeps until the earliest debounce deadline and starts the due scripts
+struct script_watcher {
+	std::vector<std::weak_ptr<script_watch>> watches;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread worker;
+	bool stopping = false;
+
+	script_watcher() {
+		this->worker = std::thread([this]() {
+			this->work();
+		});
+	}
+	~script_watcher() {
+		{
+			std::lock_guard lock(this->mutex);
+			this->stopping = true;
+		}
+		this->condition.notify_all();
+		this->worker.join();
+	}
+	script_watcher(const script_watcher&) = delete;
+	script_watcher& operator=(const script_watcher&) = delete;
+
+	//reuses the existing watch if the script still reads from the same paths, so editing doesn't resubscribe
+	std::shared_ptr<script_watch> watch(std::shared_ptr<const compiled_script> script, std::shared_ptr<script_watch> existing = nullptr) {
+		if (!script || !script->watch) {
+			return nullptr;
+		}
+		auto sources = script_watch::get_sources(*script);
+		if (existing && existing->sources == sources) {
+			std::lock_guard lock(existing->mutex);
+			existing->script = std::move(script);
+			return existing;
+		}
+
+		auto watch = std::make_shared<script_watch>();
+		watch->script = std::move(script);
+		watch->sources = std::move(sources);
+		std::weak_ptr<script_watch> weak = watch;
+		for (auto& source : watch->sources) {
+			watch->subscriptions.push_back(get_file_watcher().add(source, [this, weak](const std::string& path) {
+				if (auto watch = weak.lock()) {
+					watch->add_change(path);
+					{
+						//the scheduler either hasn't scanned yet or is already waiting, no wakeup gets lost
+						std::lock_guard lock(this->mutex);
+					}
+					this->condition.notify_one();
+				}
+			}));
+		}
+		{
+			std::lock_guard lock(this->mutex);
+			std::erase_if(this->watches, [](const std::weak_ptr<script_watch>& watch) {
+				return watch.expired();
+			});
+			this->watches.push_back(watch);
+		}
+		return watch;
+	}
+
+private:
+	//a script that is still running from the last trigger waits for another debounce period
+	void trigger(script_watch& watch) {
+		std::lock_guard lock(watch.mutex);
+		if (watch.changed.empty() || std::chrono::steady_clock::now() < watch.deadline) {
+			return;
+		}
+		if (watch.is_running()) {
+			watch.deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<qpl::f64>(watch.script->watch_debounce));
+			return;
+		}
+		auto changed = std::move(watch.changed);
+		watch.changed.clear();
+
+		auto pipeline = std::make_shared<script_pipeline>();
+		pipeline->add_script(*watch.script, changed);
+		if (pipeline->operations.empty()) {
+			return;
+		}
+		qpl::println("watch: ", changed.front(), changed.size() > 1u ? qpl::to_string(" and ", changed.size() - 1, " more") : "", " changed, running ", pipeline->operations.size(), " line(s)");
+		pipeline->start();
+		watch.pipeline = pipeline;
+		watch.job = pipeline->jobs.front();
+		watch.job_started = true;
+	}
+
+	void work() {
+		std::unique_lock lock(this->mutex);
+		while (!this->stopping) {
+			auto next = std::chrono::steady_clock::time_point::max();
+			std::vector<std::shared_ptr<script_watch>> due;
+			auto now = std::chrono::steady_clock::now();
+			for (auto& i : this->watches) {
+				auto watch = i.lock();
+				if (!watch || !watch->is_pending()) {
+					continue;
+				}
+				std::unique_lock watch_lock(watch->mutex);
+				if (watch->deadline <= now) {
+					due.push_back(watch);
+				}
+				else {
+					next = std::min(next, watch->deadline);
+				}
+			}
+			if (!due.empty()) {
+				lock.unlock();
+				for (auto& watch : due) {
+					this->trigger(*watch);
+				}
+				lock.lock();
+				continue;
+			}
+			if (next == std::chrono::steady_clock::time_point::max()) {
+				this->condition.wait(lock);
+			}
+			else {
+				this->condition.wait_until(lock, next);
+			}
+		}
+	}
+};
+
+inline script_watcher& get_script_watcher() {
+	static script_watcher watcher;
+	return watcher;
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include "widgets.hpp"
+
+//ctrl+f opens it, results update while typing. up/down pick a result, enter or a click jumps to it, escape closes.
+//lives in screen space, the caller moves the view to the returned widget
+struct search_bar {
+	qsf::text_field field;
+	qsf::rectangle background;
+	qsf::rectangle highlight;
+	std::vector<qsf::text> lines;
+	std::vector<search_match> results;
+	qsf::text more;
+	bool truncated = false;
+	//not every widget was indexed yet, the query is repeated every frame until it was
+	bool incomplete = false;
+	std::vector<widget_handle> result_handles;
+	std::wstring query;
+	qpl::size selected = 0u;
+	bool visible = false;
+
+	constexpr static qpl::f32 width = 700.f;
+	constexpr static qpl::f32 line_height = 30.f;
+	inline static const qpl::vec2 position = qpl::vec(20, 20);
+	constexpr static qpl::rgb background_color = qpl::rgb(30, 30, 40, 230);
+	constexpr static qpl::rgb highlight_color = qpl::rgb(70, 90, 140);
+
+	search_bar() {
+		this->field.set_font("consola");
+		this->field.set_text_character_size(24);
+		this->field.background_increase = { 10, 10 };
+		this->field.background.set_slope_dimension(config::widget_slope_dimension / 2);
+		this->field.background.set_color(qpl::rgb::grey_shade(50));
+		this->field.set_position(position + qpl::vec(10, 10));
+		this->background.set_color(background_color);
+		this->highlight.set_color(highlight_color);
+		this->more.set_font("consola");
+		this->more.set_character_size(18);
+		this->more.set_color(qpl::rgb::grey_shade(150));
+	}
+
+	bool has_focus() const {
+		return this->visible && this->field.has_focus();
+	}
+	void open() {
+		this->visible = true;
+		this->field.set_focus(true);
+	}
+	void close() {
+		this->visible = false;
+		this->field.set_focus(false);
+	}
+
+	qpl::hitbox get_line_hitbox(qpl::size index) const {
+		qpl::hitbox hitbox;
+		hitbox.position = position + qpl::vec(0.f, 60.f + index * line_height);
+		hitbox.dimension = qpl::vec(width, line_height);
+		return hitbox;
+	}
+	void update_results(widgets& widgets) {
+		auto found = widgets.find(this->query);
+		this->results = std::move(found.matches);
+		this->truncated = found.truncated || found.incomplete;
+		this->incomplete = found.incomplete;
+		if (this->incomplete) {
+			this->more.set_string("still indexing, more matches may follow");
+		}
+		else {
+			this->more.set_string("too many matches, only some were ranked. keep typing to narrow it down");
+		}
+		this->result_handles.clear();
+		this->lines.resize(this->results.size());
+		for (qpl::size i = 0u; i < this->results.size(); ++i) {
+			this->result_handles.push_back(widgets.get_slot_handle(this->results[i].slot));
+			auto& line = this->lines[i];
+			line.set_font("consola");
+			line.set_character_size(20);
+			line.set_color(qpl::rgb::grey_shade(220));
+			line.set_position(this->get_line_hitbox(i).position + qpl::vec(10, 4));
+			line.set_string(utf8::encode(this->results[i].snippet));
+		}
+		if (this->selected >= this->results.size()) {
+			this->selected = 0u;
+		}
+		this->update_geometry();
+	}
+	void update_geometry() {
+		qpl::hitbox hitbox;
+		hitbox.position = position;
+		hitbox.dimension = qpl::vec(width, 60.f + (this->results.size() + this->truncated) * line_height);
+		this->background.set_hitbox(hitbox);
+		this->more.set_position(this->get_line_hitbox(this->results.size()).position + qpl::vec(10, 6));
+		if (this->selected < this->results.size()) {
+			this->highlight.set_hitbox(this->get_line_hitbox(this->selected));
+		}
+	}
+
+	//returns the widget to jump to, if one was picked this frame
+	widget_handle update(const qsf::event_info& event, widgets& widgets) {
+		if (event.key_holding(sf::Keyboard::LControl) && event.key_single_pressed(sf::Keyboard::F) && !widgets.any_text_field_focus) {
+			this->open();
+		}
+		if (!this->visible) {
+			return {};
+		}
+		if (event.key_single_pressed(sf::Keyboard::Escape)) {
+			this->close();
+			return {};
+		}
+		bool enter = this->field.has_focus() && event.key_single_pressed(sf::Keyboard::Enter);
+
+		event.update(this->field);
+		auto text = this->field.wstring();
+		if (enter || text.find(L'\n') != std::wstring::npos) {
+			std::erase(text, L'\n');
+			this->field.set_string(text);
+			enter = true;
+		}
+		if (text != this->query) {
+			this->query = text;
+			this->selected = 0u;
+			this->update_results(widgets);
+		}
+		else if (this->incomplete) {
+			this->update_results(widgets);
+		}
+
+		if (!this->results.empty()) {
+			if (event.key_single_pressed(sf::Keyboard::Down)) {
+				this->selected = (this->selected + 1) % this->results.size();
+				this->update_geometry();
+			}
+			if (event.key_single_pressed(sf::Keyboard::Up)) {
+				this->selected = (this->selected + this->results.size() - 1) % this->results.size();
+				this->update_geometry();
+			}
+		}
+		if (event.left_mouse_clicked()) {
+			for (qpl::size i = 0u; i < this->results.size(); ++i) {
+				if (this->get_line_hitbox(i).contains(event.mouse_position())) {
+					this->selected = i;
+					this->update_geometry();
+					return this->result_handles[i];
+				}
+			}
+		}
+		if (enter && this->selected < this->result_handles.size()) {
+			return this->result_handles[this->selected];
+		}
+		return {};
+	}
+
+	void draw(qsf::draw_object& draw) const {
+		if (!this->visible) {
+			return;
+		}
+		draw.draw(this->background);
+		draw.draw(this->field);
+		if (this->selected < this->results.size()) {
+			draw.draw(this->highlight);
+		}
+		for (auto& line : this->lines) {
+			draw.draw(line);
+		}
+		if (this->truncated) {
+			draw.draw(this->more);
+		}
+	}
+};
@@ -0,0 +1,309 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <cwctype>
+#include <unordered_map>
+#include "text_rope.hpp"
+#include "config.hpp"
+
+struct search_match {
+	qpl::u32 slot = 0u;
+	qpl::f64 score = 0.0;
+	//the first match
+	qpl::size line = 0u;
+	qpl::size column = 0u;
+	std::wstring snippet;
+};
+struct search_results {
+	std::vector<search_match> matches;
+	//more candidates than config::search_max_candidates, only the first ones were ranked
+	bool truncated = false;
+	//some widgets weren't indexed yet, asking again later can find more
+	bool incomplete = false;
+};
+
+//case insensitive full-text index over the widget texts, keyed by widget handle slot.
+//every trigram maps to a sorted posting list of slots; a query intersects the postings of its
+//trigrams, smallest first, and only the remaining candidates are checked and ranked.
+//trigrams are taken per line since query terms never span a line break. a document counts the lines
+//holding each trigram, so an edit only folds and scans the lines it replaced and the postings
+//only change for trigrams whose count went from or to zero. a query verifies at most
+//config::search_max_candidates documents so very unselective queries still answer within a frame.
+struct search_index {
+	struct document {
+		//shares its lines with the widget
+		text_rope text;
+		text_rope folded;
+		//how many lines contain each trigram
+		std::unordered_map<qpl::u64, qpl::u32> trigrams;
+		bool indexed = false;
+	};
+	std::vector<document> documents;
+	std::unordered_map<qpl::u64, std::vector<qpl::u32>> postings;
+	qpl::size document_count = 0u;
+
+	static wchar_t fold(wchar_t c) {
+		return static_cast<wchar_t>(std::towlower(static_cast<std::wint_t>(c)));
+	}
+	static std::wstring fold(std::wstring_view text) {
+		std::wstring result(text);
+		for (auto& c : result) {
+			c = fold(c);
+		}
+		return result;
+	}
+	static qpl::u64 trigram(const wchar_t* c) {
+		return (static_cast<qpl::u64>(static_cast<qpl::u32>(c[0]) & 0x1FFFFFu) << 42) | (static_cast<qpl::u64>(static_cast<qpl::u32>(c[1]) & 0x1FFFFFu) << 21) | (static_cast<qpl::u32>(c[2]) & 0x1FFFFFu);
+	}
+	static std::vector<qpl::u64> get_trigrams(std::wstring_view folded) {
+		std::vector<qpl::u64> result;
+		if (folded.size() < 3u) {
+			return result;
+		}
+		result.reserve(folded.size() - 2u);
+		for (qpl::size i = 0u; i + 2u < folded.size(); ++i) {
+			result.push_back(trigram(folded.data() + i));
+		}
+		std::ranges::sort(result);
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+		return result;
+	}
+
+	void clear() {
+		this->documents.clear();
+		this->postings.clear();
+		this->document_count = 0u;
+	}
+	qpl::size size() const {
+		return this->document_count;
+	}
+
+	void set(qpl::u32 slot, const text_rope& text) {
+		if (slot < this->documents.size() && this->documents[slot].indexed) {
+			auto& document = this->documents[slot];
+			if (document.text.root == text.root) {
+				return;
+			}
+			this->update(slot, text, { 0u, document.text.size(), text.size() });
+		}
+		else {
+			this->update(slot, text, { 0u, 0u, text.size() });
+		}
+	}
+	//change is the line range of the indexed text that text replaced, as text_rope::update reports it
+	void update(qpl::u32 slot, const text_rope& text, text_rope::line_change change) {
+		if (slot >= this->documents.size()) {
+			this->documents.resize(slot + 1);
+		}
+		auto& document = this->documents[slot];
+		if (!document.indexed) {
+			change = { 0u, 0u, text.size() };
+			document.indexed = true;
+			++this->document_count;
+		}
+		else if (change.index + change.removed > document.text.size() || document.text.size() + change.inserted != text.size() + change.removed) {
+			change = { 0u, document.text.size(), text.size() };
+		}
+
+		//new lines are counted first, so a trigram that stays on the edited line keeps its posting
+		std::vector<std::wstring> folded(change.inserted);
+		for (qpl::size i = 0u; i < change.inserted; ++i) {
+			folded[i] = fold(text.line(change.index + i));
+			for (auto& trigram : get_trigrams(folded[i])) {
+				if (document.trigrams[trigram]++ == 0u) {
+					auto& posting = this->postings[trigram];
+					posting.insert(std::ranges::lower_bound(posting, slot), slot);
+				}
+			}
+		}
+		for (qpl::size i = 0u; i < change.removed; ++i) {
+			for (auto& trigram : get_trigrams(document.folded.line(change.index + i))) {
+				auto it = document.trigrams.find(trigram);
+				if (--it->second == 0u) {
+					document.trigrams.erase(it);
+					this->remove_posting(trigram, slot);
+				}
+			}
+		}
+		document.folded.replace(change.index, change.removed, folded);
+		document.text = text;
+	}
+	void remove(qpl::u32 slot) {
+		if (slot >= this->documents.size() || !this->documents[slot].indexed) {
+			return;
+		}
+		auto& document = this->documents[slot];
+		for (auto& [trigram, lines] : document.trigrams) {
+			this->remove_posting(trigram, slot);
+		}
+		document = {};
+		--this->document_count;
+	}
+
+	//every whitespace separated term has to appear, best matches first
+	search_results search(std::wstring_view query, qpl::size limit = config::search_max_results) const {
+		std::vector<std::wstring> terms;
+		auto folded_query = fold(query);
+		for (qpl::size i = 0u; i < folded_query.size();) {
+			while (i < folded_query.size() && std::iswspace(folded_query[i])) {
+				++i;
+			}
+			auto begin = i;
+			while (i < folded_query.size() && !std::iswspace(folded_query[i])) {
+				++i;
+			}
+			if (i != begin) {
+				terms.push_back(folded_query.substr(begin, i - begin));
+			}
+		}
+		if (terms.empty()) {
+			return {};
+		}
+
+		std::vector<const std::vector<qpl::u32>*> lists;
+		for (auto& term : terms) {
+			for (auto& trigram : get_trigrams(term)) {
+				auto it = this->postings.find(trigram);
+				if (it == this->postings.cend()) {
+					return {};
+				}
+				lists.push_back(&it->second);
+			}
+		}
+
+		search_results results;
+		auto& result = results.matches;
+		qpl::size checked = 0u;
+		auto check = [&](qpl::u32 slot) {
+			if (checked == config::search_max_candidates) {
+				results.truncated = true;
+				return false;
+			}
+			++checked;
+			search_match match;
+			if (this->rank(slot, terms, match)) {
+				result.push_back(std::move(match));
+			}
+			return true;
+		};
+		if (lists.empty()) {
+			for (qpl::u32 slot = 0u; slot < this->documents.size(); ++slot) {
+				if (this->documents[slot].indexed && !check(slot)) {
+					break;
+				}
+			}
+		}
+		else {
+			std::ranges::sort(lists, [](auto a, auto b) {
+				return a->size() < b->size();
+			});
+			//merging sorted postings is linear, much cheaper than a binary search per candidate
+			std::vector<qpl::u32> candidates = *lists.front();
+			std::vector<qpl::u32> next;
+			for (qpl::size i = 1u; i < lists.size() && !candidates.empty(); ++i) {
+				next.clear();
+				std::ranges::set_intersection(candidates, *lists[i], std::back_inserter(next));
+				std::swap(candidates, next);
+			}
+			for (auto& slot : candidates) {
+				if (!check(slot)) {
+					break;
+				}
+			}
+		}
+
+		auto better = [](const search_match& a, const search_match& b) {
+			return a.score != b.score ? a.score > b.score : a.slot < b.slot;
+		};
+		if (result.size() > limit) {
+			std::ranges::partial_sort(result, result.begin() + limit, better);
+			result.resize(limit);
+		}
+		else {
+			std::ranges::sort(result, better);
+		}
+		for (auto& match : result) {
+			match.snippet = this->get_snippet(match);
+		}
+		return results;
+	}
+
+private:
+	void remove_posting(qpl::u64 trigram, qpl::u32 slot) {
+		auto it = this->postings.find(trigram);
+		if (it == this->postings.end()) {
+			return;
+		}
+		auto& posting = it->second;
+		auto position = std::ranges::lower_bound(posting, slot);
+		if (position != posting.end() && *position == slot) {
+			posting.erase(position);
+		}
+		if (posting.empty()) {
+			this->postings.erase(it);
+		}
+	}
+
+	static bool is_word_character(wchar_t c) {
+		if (c < 128) {
+			return (c >= L'a' && c <= L'z') || (c >= L'0' && c <= L'9') || c == L'_';
+		}
+		return std::iswalnum(static_cast<std::wint_t>(c));
+	}
+	//matches at the start of a line count most, then at the start of a word, more occurrences and shorter texts break ties
+	bool rank(qpl::u32 slot, const std::vector<std::wstring>& terms, search_match& match) const {
+		auto& text = this->documents[slot].folded;
+		struct term_state {
+			qpl::size occurrences = 0u;
+			qpl::f64 best = 0.0;
+		};
+		std::vector<term_state> states(terms.size());
+		match.slot = slot;
+		match.score = 0.0;
+		match.line = qpl::size_max;
+		match.column = 0u;
+		qpl::size index = 0u;
+		text.for_each_line([&](const std::wstring& line) {
+			for (qpl::size t = 0u; t < terms.size(); ++t) {
+				auto& state = states[t];
+				auto position = line.find(terms[t]);
+				if (position != std::wstring::npos && index < match.line) {
+					match.line = index;
+					match.column = position;
+				}
+				else if (position != std::wstring::npos && index == match.line) {
+					match.column = std::min(match.column, position);
+				}
+				for (; position != std::wstring::npos && state.occurrences < config::search_counted_occurrences; position = line.find(terms[t], position + 1)) {
+					++state.occurrences;
+					if (!position) {
+						state.best = std::max(state.best, 4.0);
+					}
+					else if (!is_word_character(line[position - 1])) {
+						state.best = std::max(state.best, 2.0);
+					}
+					else {
+						state.best = std::max(state.best, 1.0);
+					}
+				}
+			}
+			++index;
+		});
+		for (auto& state : states) {
+			if (!state.occurrences) {
+				return false;
+			}
+			match.score += state.best + state.occurrences * 0.1;
+		}
+		match.score -= std::min(text.length(), qpl::size{ 100'000u }) * 1e-6;
+		return true;
+	}
+	std::wstring get_snippet(const search_match& match) const {
+		auto& line = this->documents[match.slot].text.line(match.line);
+		qpl::size begin = 0u;
+		if (match.column > config::search_snippet_length / 2) {
+			begin = match.column - config::search_snippet_length / 2;
+		}
+		auto end = std::min(line.size(), begin + config::search_snippet_length);
+		return line.substr(begin, end - begin);
+	}
+};
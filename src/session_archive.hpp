@@ -0,0 +1,327 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "widget.hpp"
+#include "mapped_file.hpp"
+#include "utf8.hpp"
+#include "crypto.hpp"
+#include "config.hpp"
+
+//fixed size widget record of the session file, text lives in the utf-8 string table
+struct session_widget_record {
+	qpl::f32 bounds[4];
+	qpl::f32 position[2];
+	qpl::f32 scale[2];
+	qpl::u64 text_offset;
+	qpl::u32 text_length;
+	qpl::u8 type;
+	qpl::u8 reserved[3];
+};
+static_assert(sizeof(session_widget_record) == 48u);
+
+//plain prefix of the session file, everything after it is encrypted in independent blocks
+struct session_file_prefix {
+	qpl::u32 magic;
+	qpl::u32 version;
+	qpl::u32 block_size;
+	qpl::u32 widget_count;
+	qpl::u64 string_table_size;
+	qpl::u64 payload_size;
+	qpl::u64 session_id;
+};
+static_assert(sizeof(session_file_prefix) == 40u);
+
+//versioned, memory mapped session snapshot.
+//layout: [session_file_prefix][payload], payload = [check][view][widget records][u32 draw order][utf-8 string table]
+//the payload is encrypted in independent fixed size blocks, so loading only decrypts the blocks holding
+//the records and draw order. string table blocks are decrypted when a widget is materialized.
+struct session_archive {
+	constexpr static qpl::u32 magic = 0x41535351u;
+	constexpr static qpl::u32 version = 3u;
+	constexpr static qpl::size check_size = sizeof(crypto::check);
+	constexpr static qpl::size view_size = 4u * sizeof(qpl::f32);
+	constexpr static qpl::size records_begin = check_size + view_size;
+
+	//the last decrypted block, every thread that decodes keeps its own
+	struct block_cache {
+		qpl::size block = qpl::size_max;
+		std::string data;
+	};
+
+	mapped_file file;
+	session_file_prefix prefix{};
+	std::string index;
+	std::vector<qpl::size> order;
+	qpl::vec2 view_position;
+	qpl::vec2 view_scale;
+
+	//used by the ui thread
+	mutable block_cache cache;
+
+	qpl::size size() const {
+		return this->prefix.widget_count;
+	}
+	qpl::size order_begin() const {
+		return records_begin + this->size() * sizeof(session_widget_record);
+	}
+	qpl::size strings_begin() const {
+		return this->order_begin() + this->size() * sizeof(qpl::u32);
+	}
+	//identifies this exact file, the journal stores it to detect that it belongs to another snapshot
+	qpl::u64 identity() const {
+		auto hash = 0xCBF29CE484222325ull;
+		auto bytes = reinterpret_cast<const qpl::u8*>(&this->prefix);
+		for (qpl::size i = 0u; i < sizeof(this->prefix); ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	static qpl::u32 read_version(std::string_view data) {
+		if (data.size() < 2u * sizeof(qpl::u32)) {
+			return 0u;
+		}
+		qpl::u32 value = 0u;
+		std::memcpy(&value, data.data(), sizeof(value));
+		if (value != magic) {
+			return 0u;
+		}
+		std::memcpy(&value, data.data() + sizeof(magic), sizeof(value));
+		return value;
+	}
+
+	static std::string encode(const std::vector<widget_record>& records, const std::vector<qpl::hitbox>& bounds, const std::vector<qpl::size>& order, qpl::vec2 view_position, qpl::vec2 view_scale) {
+		std::vector<session_widget_record> fixed(records.size());
+		std::string strings;
+		for (qpl::size i = 0u; i < records.size(); ++i) {
+			auto text = utf8::encode(records[i].text);
+			auto& record = fixed[i];
+			record = session_widget_record{};
+			record.bounds[0] = bounds[i].position.x;
+			record.bounds[1] = bounds[i].position.y;
+			record.bounds[2] = bounds[i].dimension.x;
+			record.bounds[3] = bounds[i].dimension.y;
+			record.position[0] = records[i].position.x;
+			record.position[1] = records[i].position.y;
+			record.scale[0] = records[i].scale.x;
+			record.scale[1] = records[i].scale.y;
+			record.text_offset = strings.size();
+			record.text_length = static_cast<qpl::u32>(text.size());
+			record.type = static_cast<qpl::u8>(records[i].type);
+			strings.append(text);
+		}
+		std::vector<qpl::u32> order32(order.cbegin(), order.cend());
+		std::array<qpl::f32, 4u> view = { view_position.x, view_position.y, view_scale.x, view_scale.y };
+
+		std::string payload;
+		payload.reserve(records_begin + fixed.size() * sizeof(session_widget_record) + order32.size() * sizeof(qpl::u32) + strings.size());
+		payload.append(reinterpret_cast<const char*>(crypto::check.data()), check_size);
+		payload.append(reinterpret_cast<const char*>(view.data()), view_size);
+		payload.append(reinterpret_cast<const char*>(fixed.data()), fixed.size() * sizeof(session_widget_record));
+		payload.append(reinterpret_cast<const char*>(order32.data()), order32.size() * sizeof(qpl::u32));
+		payload.append(strings);
+
+		session_file_prefix prefix{};
+		prefix.magic = magic;
+		prefix.version = version;
+		prefix.block_size = static_cast<qpl::u32>(config::session_block_size);
+		prefix.widget_count = static_cast<qpl::u32>(records.size());
+		prefix.string_table_size = strings.size();
+		prefix.payload_size = payload.size();
+		prefix.session_id = std::random_device{}() ^ (qpl::u64(std::random_device{}()) << 32);
+
+		std::string result(reinterpret_cast<const char*>(&prefix), sizeof(prefix));
+		result.reserve(sizeof(prefix) + payload.size());
+		for (qpl::size i = 0u; i < payload.size(); i += prefix.block_size) {
+			result.append(qpl::encrypted_keep_size(payload.substr(i, prefix.block_size), crypto::key));
+		}
+		return result;
+	}
+
+	std::string decrypt_block(qpl::size block) const {
+		auto begin = block * this->prefix.block_size;
+		auto length = std::min<qpl::size>(this->prefix.block_size, this->prefix.payload_size - begin);
+		std::string data(this->file.data + sizeof(session_file_prefix) + begin, length);
+		qpl::decrypt_keep_size(data, crypto::key);
+		return data;
+	}
+	//decrypts the payload range [begin, begin + length) block by block
+	std::string decrypt_range(qpl::size begin, qpl::size length, block_cache& cache) const {
+		std::string result;
+		result.reserve(length);
+		auto end = begin + length;
+		while (begin < end) {
+			auto block = begin / this->prefix.block_size;
+			auto block_begin = block * this->prefix.block_size;
+			if (block != cache.block) {
+				cache.data = this->decrypt_block(block);
+				cache.block = block;
+			}
+			auto offset = begin - block_begin;
+			auto count = std::min<qpl::size>(end - begin, cache.data.size() - offset);
+			result.append(cache.data, offset, count);
+			begin += count;
+		}
+		return result;
+	}
+
+	//maps the file and decrypts only the record and draw order blocks
+	bool open(const std::string& path) {
+		this->clear();
+		if (!this->file.open(path)) {
+			return false;
+		}
+		if (read_version(this->file.view()) != version || this->file.size < sizeof(session_file_prefix)) {
+			this->clear();
+			return false;
+		}
+		std::memcpy(&this->prefix, this->file.data, sizeof(this->prefix));
+		if (this->prefix.block_size == 0u ||
+			sizeof(session_file_prefix) + this->prefix.payload_size > this->file.size ||
+			this->strings_begin() + this->prefix.string_table_size != this->prefix.payload_size) {
+			this->clear();
+			return false;
+		}
+
+		this->index = this->decrypt_range(0u, this->strings_begin(), this->cache);
+		if (std::memcmp(this->index.data(), crypto::check.data(), check_size) != 0) {
+			this->clear();
+			return false;
+		}
+		std::array<qpl::f32, 4u> view;
+		std::memcpy(view.data(), this->index.data() + check_size, view_size);
+		this->view_position = qpl::vec(view[0], view[1]);
+		this->view_scale = qpl::vec(view[2], view[3]);
+
+		this->order.resize(this->size());
+		for (qpl::size i = 0u; i < this->order.size(); ++i) {
+			qpl::u32 value = 0u;
+			std::memcpy(&value, this->index.data() + this->order_begin() + i * sizeof(qpl::u32), sizeof(value));
+			if (value >= this->size()) {
+				this->clear();
+				return false;
+			}
+			this->order[i] = value;
+		}
+		return true;
+	}
+
+	session_widget_record get_fixed_record(qpl::size index) const {
+		session_widget_record record;
+		std::memcpy(&record, this->index.data() + records_begin + index * sizeof(session_widget_record), sizeof(record));
+		return record;
+	}
+	qpl::hitbox get_bounds(qpl::size index) const {
+		auto record = this->get_fixed_record(index);
+		qpl::hitbox hitbox;
+		hitbox.position = qpl::vec(record.bounds[0], record.bounds[1]);
+		hitbox.dimension = qpl::vec(record.bounds[2], record.bounds[3]);
+		return hitbox;
+	}
+	//only reads the mapped file and the index, so threads with their own cache can decode at the same time
+	std::shared_ptr<const widget_record> decode(qpl::size index, block_cache& cache) const {
+		auto fixed = this->get_fixed_record(index);
+		auto record = std::make_shared<widget_record>();
+		record->position = qpl::vec(fixed.position[0], fixed.position[1]);
+		record->scale = qpl::vec(fixed.scale[0], fixed.scale[1]);
+		record->type = static_cast<widget_type>(fixed.type);
+		if (fixed.text_offset + fixed.text_length <= this->prefix.string_table_size) {
+			record->text.assign(utf8::decode(this->decrypt_range(this->strings_begin() + fixed.text_offset, fixed.text_length, cache)));
+		}
+		return record;
+	}
+	std::shared_ptr<const widget_record> decode(qpl::size index) const {
+		return this->decode(index, this->cache);
+	}
+
+	void clear() {
+		this->file.close();
+		this->prefix = session_file_prefix{};
+		this->index.clear();
+		this->index.shrink_to_fit();
+		this->order.clear();
+		this->cache = {};
+	}
+};
+
+//decodes the records of an archive on a worker thread in file order, the ui thread only applies them.
+//the worker stays at most config::widget_decode_ahead records ahead of what was taken
+struct archive_decoder {
+	struct decoded {
+		qpl::size index = qpl::size_max;
+		std::shared_ptr<const widget_record> record;
+	};
+	const session_archive* archive = nullptr;
+	std::deque<decoded> ready;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread worker;
+	bool stopping = false;
+
+	archive_decoder() = default;
+	~archive_decoder() {
+		this->stop();
+	}
+	archive_decoder(const archive_decoder&) = delete;
+	archive_decoder& operator=(const archive_decoder&) = delete;
+
+	//the archive must not change until stop() returned
+	void start(const session_archive& archive) {
+		this->stop();
+		this->archive = &archive;
+		this->stopping = false;
+		this->worker = std::thread([this]() {
+			this->work();
+		});
+	}
+	void stop() {
+		if (!this->worker.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard lock(this->mutex);
+			this->stopping = true;
+		}
+		this->condition.notify_all();
+		this->worker.join();
+		this->ready.clear();
+		this->archive = nullptr;
+	}
+	bool take(decoded& result) {
+		{
+			std::lock_guard lock(this->mutex);
+			if (this->ready.empty()) {
+				return false;
+			}
+			result = std::move(this->ready.front());
+			this->ready.pop_front();
+		}
+		this->condition.notify_one();
+		return true;
+	}
+
+private:
+	void work() {
+		session_archive::block_cache cache;
+		for (qpl::size i = 0u; i < this->archive->size(); ++i) {
+			{
+				std::unique_lock lock(this->mutex);
+				this->condition.wait(lock, [&]() {
+					return this->stopping || this->ready.size() < config::widget_decode_ahead;
+				});
+				if (this->stopping) {
+					return;
+				}
+			}
+			auto record = this->archive->decode(i, cache);
+			std::lock_guard lock(this->mutex);
+			this->ready.push_back({ i, std::move(record) });
+		}
+	}
+};
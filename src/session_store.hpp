@@ -0,0 +1,444 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <atomic>
+#include "widgets.hpp"
+#include "crypto.hpp"
+#include "config.hpp"
+#include "profiler.hpp"
+
+enum class journal_record : qpl::u8 {
+	created,
+	moved,
+	text,
+	deleted,
+	raised,
+	view,
+};
+
+struct session_snapshot_entry {
+	qpl::u64 id = 0u;
+	qpl::u8 changes = 0u;
+	std::shared_ptr<const widget_record> record;
+	qpl::hitbox bounds;
+};
+
+//everything a save needs, captured on the ui thread. a full snapshot holds every widget in index order
+struct session_snapshot {
+	std::vector<session_snapshot_entry> entries;
+	std::vector<qpl::size> order;
+	std::vector<qpl::u64> deleted_ids;
+	std::vector<qpl::u64> raised_ids;
+	qpl::vec2 view_position;
+	qpl::vec2 view_scale;
+	bool full = false;
+};
+
+//session persistence as a full snapshot (see session_archive) plus an append-only journal of encrypted per-widget changes.
+//the journal header holds a checksum of the snapshot it belongs to, so a journal left over from
+//an interrupted compaction is never replayed onto the wrong snapshot.
+struct session_store {
+	std::string snapshot_path = config::session_snapshot_path;
+	std::string journal_path = config::session_journal_path;
+
+	qpl::size journal_records = 0u;
+	qpl::u64 journal_bytes = 0u;
+	qpl::u64 snapshot_bytes = 0u;
+	qpl::u64 snapshot_checksum = 0u;
+
+	qpl::vec2 saved_view_position;
+	qpl::vec2 saved_view_scale;
+	std::atomic_bool compaction_due = true;
+
+	constexpr static qpl::u32 journal_magic = 0x4A535654u;
+
+	static qpl::u64 checksum(const std::string& data) {
+		auto hash = 0xCBF29CE484222325ull;
+		for (auto& c : data) {
+			hash ^= static_cast<qpl::u8>(c);
+			hash *= 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	//on windows the snapshot can't be replaced while placeholder widgets still map it. it's renamed to
+	//path.old instead, the mapping keeps reading it there until the archive is closed
+	static bool write_atomic(const std::string& path, const std::string& data) {
+		auto temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				return false;
+			}
+			file.write(data.data(), data.size());
+			file.flush();
+			if (!file) {
+				return false;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, path, error);
+#if defined(_WIN32)
+		if (error) {
+			auto aside = path + ".old";
+			std::error_code ignored;
+			std::filesystem::remove(aside, ignored);
+			error.clear();
+			std::filesystem::rename(path, aside, error);
+			if (!error) {
+				std::filesystem::rename(temporary, path, error);
+			}
+		}
+#endif
+		if (error) {
+			qpl::println("couldn't replace \"", path, "\": ", error.message());
+		}
+		return !error;
+	}
+
+	std::string journal_header() const {
+		std::string header(sizeof(journal_magic) + sizeof(this->snapshot_checksum), '\0');
+		std::memcpy(header.data(), &journal_magic, sizeof(journal_magic));
+		std::memcpy(header.data() + sizeof(journal_magic), &this->snapshot_checksum, sizeof(this->snapshot_checksum));
+		return header;
+	}
+
+	//the ui thread part of a save, only shares the cached widget records so it stays cheap
+	session_snapshot capture(widgets& widgets, const qsf::view_control& view) {
+		profile_scope scope(profile_section::save_load);
+		session_snapshot snapshot;
+		snapshot.full = this->compaction_due;
+		snapshot.view_position = view.position;
+		snapshot.view_scale = view.scale;
+
+		std::vector<qpl::size> raised;
+		for (qpl::size i = 0u; i < widgets.widgets.size(); ++i) {
+			auto& widget = widgets.widgets[i];
+			if (snapshot.full || widget.changes) {
+				snapshot.entries.push_back({ widget.id, widget.changes, widgets.get_record(i), widgets.get_bounds(i) });
+			}
+			if (widget.changes & widget_changes::raised) {
+				raised.push_back(i);
+			}
+			widget.changes = 0u;
+		}
+
+		if (snapshot.full) {
+			snapshot.order = widgets.draw_order.to_vector();
+			widgets.renumber_ids();
+			widgets.deleted_ids.clear();
+			this->compaction_due = false;
+			return snapshot;
+		}
+
+		snapshot.deleted_ids = std::move(widgets.deleted_ids);
+		widgets.deleted_ids.clear();
+
+		//raising in depth order reproduces the relative order of everything that was brought to front
+		std::ranges::sort(raised, [&](qpl::size a, qpl::size b) {
+			return widgets.draw_order.depth(a) < widgets.draw_order.depth(b);
+		});
+		for (auto& i : raised) {
+			snapshot.raised_ids.push_back(widgets.widgets[i].id);
+		}
+		return snapshot;
+	}
+
+	//writes the whole session, the snapshot file keeps the legacy layout
+	bool compact(const session_snapshot& snapshot) {
+		std::vector<widget_record> records;
+		std::vector<qpl::hitbox> bounds;
+		records.reserve(snapshot.entries.size());
+		bounds.reserve(snapshot.entries.size());
+		for (auto& entry : snapshot.entries) {
+			records.push_back(*entry.record);
+			bounds.push_back(entry.bounds);
+		}
+		auto data = session_archive::encode(records, bounds, snapshot.order, snapshot.view_position, snapshot.view_scale);
+		if (!write_atomic(this->snapshot_path, data)) {
+			qpl::println("couldn't write session snapshot!");
+			this->compaction_due = true;
+			return false;
+		}
+		this->snapshot_bytes = data.size();
+		this->snapshot_checksum = checksum(data.substr(0u, sizeof(session_file_prefix)));
+
+		if (!write_atomic(this->journal_path, this->journal_header())) {
+			qpl::println("couldn't write session journal!");
+			this->compaction_due = true;
+			return false;
+		}
+		this->journal_records = 0u;
+		this->journal_bytes = 0u;
+		this->saved_view_position = snapshot.view_position;
+		this->saved_view_scale = snapshot.view_scale;
+		return true;
+	}
+
+	bool needs_compaction() const {
+		return this->journal_records >= config::session_journal_max_records ||
+			this->journal_bytes > this->snapshot_bytes / 2 + config::session_journal_min_bytes;
+	}
+
+	void append_record(std::string& journal, qpl::save_state& state) {
+		auto payload = qpl::encrypted_keep_size(state.get_finalized_string(), crypto::key);
+		auto length = static_cast<qpl::u32>(payload.size());
+		auto check = static_cast<qpl::u32>(checksum(payload));
+		journal.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		journal.append(reinterpret_cast<const char*>(&check), sizeof(check));
+		journal.append(payload);
+		++this->journal_records;
+	}
+
+	std::string serialize_changes(const session_snapshot& snapshot) {
+		std::string journal;
+		for (auto& id : snapshot.deleted_ids) {
+			qpl::save_state state;
+			state.save(journal_record::deleted, id);
+			this->append_record(journal, state);
+		}
+		for (auto& entry : snapshot.entries) {
+			auto& record = *entry.record;
+			if (entry.changes & widget_changes::created) {
+				qpl::save_state state;
+				state.save(journal_record::created, entry.id, record);
+				this->append_record(journal, state);
+				continue;
+			}
+			if (entry.changes & widget_changes::moved) {
+				qpl::save_state state;
+				state.save(journal_record::moved, entry.id, record.position, record.scale);
+				this->append_record(journal, state);
+			}
+			if (entry.changes & widget_changes::text) {
+				qpl::save_state state;
+				state.save(journal_record::text, entry.id, record.text.wstring());
+				this->append_record(journal, state);
+			}
+		}
+		for (auto& id : snapshot.raised_ids) {
+			qpl::save_state state;
+			state.save(journal_record::raised, id);
+			this->append_record(journal, state);
+		}
+
+		if (snapshot.view_position != this->saved_view_position || snapshot.view_scale != this->saved_view_scale) {
+			qpl::save_state state;
+			state.save(journal_record::view, snapshot.view_position, snapshot.view_scale);
+			this->append_record(journal, state);
+			this->saved_view_position = snapshot.view_position;
+			this->saved_view_scale = snapshot.view_scale;
+		}
+		return journal;
+	}
+
+	//the serialization, encryption and file part of a save, safe to run off the ui thread
+	bool write(const session_snapshot& snapshot) {
+		profile_scope scope(profile_section::save_load);
+		if (snapshot.full) {
+			return this->compact(snapshot);
+		}
+		auto journal = this->serialize_changes(snapshot);
+		if (!journal.empty()) {
+			std::ofstream file(this->journal_path, std::ios::binary | std::ios::app);
+			file.write(journal.data(), journal.size());
+			file.flush();
+			if (!file) {
+				qpl::println("couldn't append to session journal!");
+				this->compaction_due = true;
+				return false;
+			}
+			this->journal_bytes += journal.size();
+		}
+		if (this->needs_compaction()) {
+			this->compaction_due = true;
+		}
+		return true;
+	}
+
+	bool save(widgets& widgets, const qsf::view_control& view) {
+		return this->write(this->capture(widgets, view));
+	}
+
+	void replay(widgets& widgets, qsf::view_control& view, qpl::load_state& state, std::unordered_map<qpl::u64, qpl::size>& indices) {
+		journal_record type;
+		qpl::u64 id = 0u;
+		state.load(type);
+
+		auto find = [&](qpl::u64 id) {
+			auto it = indices.find(id);
+			return it == indices.cend() ? qpl::size_max : it->second;
+		};
+
+		switch (type) {
+		case journal_record::created: {
+			state.load(id);
+			widget widget;
+			state.load(widget);
+			widget.id = id;
+			indices[id] = widgets.insert(std::move(widget));
+			widgets.next_id = std::max(widgets.next_id, id + 1);
+		} break;
+		case journal_record::moved: {
+			state.load(id);
+			auto index = find(id);
+			qpl::vec2 position;
+			qpl::vec2 scale;
+			state.load(position, scale);
+			if (index != qpl::size_max) {
+				widgets.materialize(index);
+				widgets.widgets[index].set_position(position);
+				widgets.widgets[index].set_scale(scale);
+			}
+		} break;
+		case journal_record::text: {
+			state.load(id);
+			auto index = find(id);
+			std::wstring text;
+			state.load(text);
+			if (index != qpl::size_max) {
+				widgets.materialize(index);
+				widgets.widgets[index].set_text(text);
+			}
+		} break;
+		case journal_record::deleted: {
+			state.load(id);
+			auto index = find(id);
+			if (index != qpl::size_max) {
+				widgets.erase(index);
+				indices.erase(id);
+				if (index < widgets.widgets.size()) {
+					indices[widgets.widgets[index].id] = index;
+				}
+			}
+		} break;
+		case journal_record::raised: {
+			state.load(id);
+			auto index = find(id);
+			if (index != qpl::size_max) {
+				widgets.draw_order.raise(index);
+				widgets.draw_order.compact_if_sparse();
+			}
+		} break;
+		case journal_record::view: {
+			state.load(view.position, view.scale);
+		} break;
+		}
+	}
+
+	void replay_journal(widgets& widgets, qsf::view_control& view) {
+		std::error_code error;
+		qpl::u64 size = std::filesystem::file_size(this->journal_path, error);
+		if (error) {
+			return;
+		}
+		qpl::u64 good_size = 0u;
+		{
+			std::ifstream file(this->journal_path, std::ios::binary);
+			if (!file) {
+				return;
+			}
+			qpl::u32 magic = 0u;
+			qpl::u64 snapshot = 0u;
+			file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+			file.read(reinterpret_cast<char*>(&snapshot), sizeof(snapshot));
+			if (!file || magic != journal_magic || snapshot != this->snapshot_checksum) {
+				return;
+			}
+			good_size = sizeof(magic) + sizeof(snapshot);
+			std::unordered_map<qpl::u64, qpl::size> indices;
+			for (qpl::size i = 0u; i < widgets.widgets.size(); ++i) {
+				indices[widgets.widgets[i].id] = i;
+			}
+
+			while (good_size < size) {
+				qpl::u32 length = 0u;
+				qpl::u32 check = 0u;
+				file.read(reinterpret_cast<char*>(&length), sizeof(length));
+				file.read(reinterpret_cast<char*>(&check), sizeof(check));
+				//the length of a torn header can be anything, it has to fit into what's left of the file
+				auto header_end = good_size + sizeof(length) + sizeof(check);
+				if (!file || length > size - std::min(size, header_end)) {
+					break;
+				}
+				std::string payload(length, '\0');
+				file.read(payload.data(), length);
+				if (!file || static_cast<qpl::u32>(checksum(payload)) != check) {
+					break;
+				}
+				good_size = header_end + length;
+				this->journal_bytes += sizeof(length) + sizeof(check) + length;
+				++this->journal_records;
+
+				qpl::decrypt_keep_size(payload, crypto::key);
+				qpl::load_state state;
+				state.set_string(payload);
+				this->replay(widgets, view, state, indices);
+			}
+		}
+
+		//a torn record at the end of the journal is where the last write got interrupted. it's cut off,
+		//otherwise the next save would append behind it and every later record would be unreachable
+		if (good_size < size) {
+			qpl::println("session journal: dropping incomplete record.");
+			std::filesystem::resize_file(this->journal_path, good_size, error);
+			if (error) {
+				this->compaction_due = true;
+			}
+		}
+	}
+
+	//snapshots in the original format are read whole and rewritten in the current one on the next save
+	bool load_previous_version(widgets& widgets, qsf::view_control& view) {
+		auto data = qpl::filesys::read_file(this->snapshot_path);
+		this->snapshot_bytes = data.size();
+		this->snapshot_checksum = checksum(data);
+		this->compaction_due = true;
+
+		if (session_archive::read_version(data) != 0u) {
+			return false;
+		}
+
+		//the original format, one qpl::save_state blob encrypted as a whole
+		qpl::decrypt_keep_size(data, crypto::key);
+
+		std::array<qpl::u64, 4u> confirm;
+		qpl::load_state state;
+		state.set_string(data);
+		state.load(widgets, view.position, view.scale, confirm);
+		return confirm == crypto::check;
+	}
+
+	bool load(widgets& widgets, qsf::view_control& view) {
+		profile_scope scope(profile_section::save_load);
+		if (!std::filesystem::exists(this->snapshot_path)) {
+			this->compaction_due = true;
+			return false;
+		}
+		this->journal_records = 0u;
+		this->journal_bytes = 0u;
+
+		session_archive archive;
+		if (archive.open(this->snapshot_path)) {
+			this->snapshot_bytes = archive.file.size;
+			this->snapshot_checksum = archive.identity();
+			view.position = archive.view_position;
+			view.scale = archive.view_scale;
+			widgets.load_archive(std::move(archive));
+		}
+		else if (!this->load_previous_version(widgets, view)) {
+			this->snapshot_checksum = 0u;
+			this->compaction_due = true;
+			return false;
+		}
+		this->replay_journal(widgets, view);
+		widgets.loaded();
+
+		this->saved_view_position = view.position;
+		this->saved_view_scale = view.scale;
+		this->compaction_due = this->compaction_due || this->needs_compaction();
+		return true;
+	}
+};
@@ -0,0 +1,290 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include "config.hpp"
+
+//uniform grid over world space hitboxes, entries are addressed by widget index
+struct spatial_grid {
+	struct cell_range {
+		qpl::i32 x1 = 0;
+		qpl::i32 y1 = 0;
+		qpl::i32 x2 = -1;
+		qpl::i32 y2 = -1;
+		bool valid = false;
+
+		bool operator==(const cell_range& other) const = default;
+	};
+
+	qpl::f32 cell_size = config::widget_grid_cell_size;
+	std::unordered_map<qpl::u64, std::vector<qpl::size>> cells;
+	std::vector<cell_range> ranges;
+	std::vector<qpl::hitbox> hitboxes;
+	cell_range bounds;
+	qpl::size count = 0u;
+
+	mutable std::vector<qpl::u32> visit_marks;
+	mutable qpl::u32 visit_mark = 0u;
+
+	static qpl::u64 cell_key(qpl::i32 x, qpl::i32 y) {
+		return (qpl::u64(qpl::u32(x)) << 32) | qpl::u64(qpl::u32(y));
+	}
+	qpl::i32 cell_coordinate(qpl::f32 value) const {
+		return static_cast<qpl::i32>(std::floor(value / this->cell_size));
+	}
+	cell_range get_range(qpl::hitbox hitbox) const {
+		cell_range result;
+		result.x1 = this->cell_coordinate(hitbox.position.x);
+		result.y1 = this->cell_coordinate(hitbox.position.y);
+		result.x2 = this->cell_coordinate(hitbox.position.x + hitbox.dimension.x);
+		result.y2 = this->cell_coordinate(hitbox.position.y + hitbox.dimension.y);
+		result.valid = true;
+		return result;
+	}
+
+	bool empty() const {
+		return this->count == 0u;
+	}
+	qpl::size size() const {
+		return this->ranges.size();
+	}
+	void clear() {
+		this->cells.clear();
+		this->ranges.clear();
+		this->hitboxes.clear();
+		this->visit_marks.clear();
+		this->bounds = cell_range{};
+		this->count = 0u;
+	}
+	void resize(qpl::size size) {
+		for (qpl::size i = size; i < this->ranges.size(); ++i) {
+			this->remove(i);
+		}
+		this->ranges.resize(size);
+		this->hitboxes.resize(size);
+		this->visit_marks.resize(size);
+	}
+
+	void set(qpl::size index, qpl::hitbox hitbox) {
+		if (index >= this->ranges.size()) {
+			this->resize(index + 1);
+		}
+		this->hitboxes[index] = hitbox;
+
+		auto range = this->get_range(hitbox);
+		if (range == this->ranges[index]) {
+			return;
+		}
+		this->remove_from_cells(index);
+		this->add_to_cells(index, range);
+	}
+	void remove(qpl::size index) {
+		if (index < this->ranges.size()) {
+			this->remove_from_cells(index);
+		}
+	}
+
+	//used when the entry at "from" takes over the index "to", e.g. swap-and-pop on delete
+	void move_index(qpl::size from, qpl::size to) {
+		if (from == to || from >= this->ranges.size()) {
+			return;
+		}
+		this->remove(to);
+		auto range = this->ranges[from];
+		if (range.valid) {
+			this->for_each_cell(range, [&](std::vector<qpl::size>& cell) {
+				for (auto& i : cell) {
+					if (i == from) {
+						i = to;
+					}
+				}
+			});
+		}
+		this->ranges[to] = range;
+		this->hitboxes[to] = this->hitboxes[from];
+		this->ranges[from] = cell_range{};
+	}
+
+	bool collides(qpl::hitbox hitbox) const {
+		if (this->empty()) {
+			return false;
+		}
+		auto range = this->clamped(this->get_range(hitbox));
+		for (qpl::i32 y = range.y1; y <= range.y2; ++y) {
+			for (qpl::i32 x = range.x1; x <= range.x2; ++x) {
+				auto it = this->cells.find(cell_key(x, y));
+				if (it == this->cells.cend()) {
+					continue;
+				}
+				for (auto& i : it->second) {
+					if (hitbox.collides(this->hitboxes[i])) {
+						return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	template<typename F>
+	void for_each_in(qpl::hitbox hitbox, F&& function) const {
+		if (this->empty()) {
+			return;
+		}
+		auto mark = this->next_visit_mark();
+		auto range = this->clamped(this->get_range(hitbox));
+		for (qpl::i32 y = range.y1; y <= range.y2; ++y) {
+			for (qpl::i32 x = range.x1; x <= range.x2; ++x) {
+				auto it = this->cells.find(cell_key(x, y));
+				if (it == this->cells.cend()) {
+					continue;
+				}
+				for (auto& i : it->second) {
+					if (this->visit_marks[i] != mark) {
+						this->visit_marks[i] = mark;
+						if (hitbox.collides(this->hitboxes[i])) {
+							function(i);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	template<typename F>
+	void for_each_at(qpl::vec2 position, F&& function) const {
+		auto it = this->cells.find(cell_key(this->cell_coordinate(position.x), this->cell_coordinate(position.y)));
+		if (it == this->cells.cend()) {
+			return;
+		}
+		for (auto& i : it->second) {
+			if (this->hitboxes[i].contains(position)) {
+				function(i);
+			}
+		}
+	}
+
+	//visits entries ring by ring around position, each ring sorted by center distance.
+	//stops and returns true as soon as function returns true.
+	template<typename F>
+	bool for_each_nearest(qpl::vec2 position, F&& function) const {
+		if (this->empty()) {
+			return false;
+		}
+		auto mark = this->next_visit_mark();
+		auto cx = this->cell_coordinate(position.x);
+		auto cy = this->cell_coordinate(position.y);
+
+		auto max_ring = std::max({
+			std::abs(cx - this->bounds.x1), std::abs(this->bounds.x2 - cx),
+			std::abs(cy - this->bounds.y1), std::abs(this->bounds.y2 - cy)
+		});
+
+		std::vector<std::pair<qpl::size, qpl::f64>> ring;
+		qpl::size visited = 0u;
+		for (qpl::i32 r = 0; r <= max_ring && visited < this->count; ++r) {
+			ring.clear();
+			auto visit = [&](qpl::i32 x, qpl::i32 y) {
+				auto it = this->cells.find(cell_key(x, y));
+				if (it == this->cells.cend()) {
+					return;
+				}
+				for (auto& i : it->second) {
+					if (this->visit_marks[i] != mark) {
+						this->visit_marks[i] = mark;
+						ring.push_back({ i, (position - this->hitboxes[i].get_center()).length() });
+					}
+				}
+			};
+			if (r == 0) {
+				visit(cx, cy);
+			}
+			else {
+				for (qpl::i32 x = cx - r; x <= cx + r; ++x) {
+					visit(x, cy - r);
+					visit(x, cy + r);
+				}
+				for (qpl::i32 y = cy - r + 1; y <= cy + r - 1; ++y) {
+					visit(cx - r, y);
+					visit(cx + r, y);
+				}
+			}
+			visited += ring.size();
+			qpl::sort(ring, [](auto a, auto b) {
+				return a.second < b.second;
+				});
+
+			for (auto& i : ring) {
+				if (function(i.first)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+private:
+	template<typename F>
+	void for_each_cell(cell_range range, F&& function) {
+		for (qpl::i32 y = range.y1; y <= range.y2; ++y) {
+			for (qpl::i32 x = range.x1; x <= range.x2; ++x) {
+				function(this->cells[cell_key(x, y)]);
+			}
+		}
+	}
+	cell_range clamped(cell_range range) const {
+		range.x1 = std::max(range.x1, this->bounds.x1);
+		range.y1 = std::max(range.y1, this->bounds.y1);
+		range.x2 = std::min(range.x2, this->bounds.x2);
+		range.y2 = std::min(range.y2, this->bounds.y2);
+		return range;
+	}
+	qpl::u32 next_visit_mark() const {
+		++this->visit_mark;
+		if (this->visit_mark == 0u) {
+			std::fill(this->visit_marks.begin(), this->visit_marks.end(), 0u);
+			this->visit_mark = 1u;
+		}
+		return this->visit_mark;
+	}
+	void add_to_cells(qpl::size index, cell_range range) {
+		this->for_each_cell(range, [&](std::vector<qpl::size>& cell) {
+			cell.push_back(index);
+		});
+		this->ranges[index] = range;
+		++this->count;
+
+		if (!this->bounds.valid) {
+			this->bounds = range;
+		}
+		else {
+			this->bounds.x1 = std::min(this->bounds.x1, range.x1);
+			this->bounds.y1 = std::min(this->bounds.y1, range.y1);
+			this->bounds.x2 = std::max(this->bounds.x2, range.x2);
+			this->bounds.y2 = std::max(this->bounds.y2, range.y2);
+		}
+	}
+	void remove_from_cells(qpl::size index) {
+		auto range = this->ranges[index];
+		if (!range.valid) {
+			return;
+		}
+		for (qpl::i32 y = range.y1; y <= range.y2; ++y) {
+			for (qpl::i32 x = range.x1; x <= range.x2; ++x) {
+				auto it = this->cells.find(cell_key(x, y));
+				if (it == this->cells.end()) {
+					continue;
+				}
+				auto& cell = it->second;
+				auto found = std::ranges::find(cell, index);
+				if (found != cell.end()) {
+					*found = cell.back();
+					cell.pop_back();
+				}
+				if (cell.empty()) {
+					this->cells.erase(it);
+				}
+			}
+		}
+		this->ranges[index] = cell_range{};
+		--this->count;
+	}
+};
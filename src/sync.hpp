@@ -0,0 +1,525 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include "copy_engine.hpp"
+#include "config.hpp"
+
+struct sync_options {
+	//compare contents when size matches but the write time differs, so touched files aren't copied
+	bool hash = false;
+	//print the planned operations without touching anything
+	bool dry_run = false;
+	//trust directory write times and skip subtrees whose directory didn't change since the last sync.
+	//this only notices added, removed and renamed entries (which includes atomic saves), not in-place writes.
+	bool fast = false;
+};
+
+struct sync_entry {
+	bool directory = false;
+	qpl::u64 size = 0u;
+	qpl::i64 time = 0;
+};
+
+//state of both sides after the last successful sync, persisted per directory pair
+struct sync_manifest {
+	struct record {
+		bool directory = false;
+		qpl::u64 size = 0u;
+		qpl::i64 time_a = 0;
+		qpl::i64 time_b = 0;
+		qpl::u64 hash = 0u;
+	};
+	constexpr static qpl::u32 magic = 0x314D5354u;
+	std::map<std::string, record> records;
+
+	static qpl::u64 fnv1a(const void* data, qpl::size size, qpl::u64 hash = 0xCBF29CE484222325ull) {
+		auto bytes = static_cast<const qpl::u8*>(data);
+		for (qpl::size i = 0u; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+		return hash;
+	}
+	static std::filesystem::path get_path(const std::filesystem::path& a, const std::filesystem::path& b) {
+		auto key = a.generic_string() + '\n' + b.generic_string();
+		auto hash = fnv1a(key.data(), key.size());
+		std::ostringstream name;
+		name << std::hex << hash << ".manifest";
+		return std::filesystem::path(config::sync_manifest_directory) / name.str();
+	}
+
+	bool load(const std::filesystem::path& path) {
+		this->records.clear();
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+		auto read = [&](auto& value) {
+			file.read(reinterpret_cast<char*>(&value), sizeof(value));
+		};
+		qpl::u32 check = 0u;
+		qpl::u64 count = 0u;
+		read(check);
+		read(count);
+		if (check != magic) {
+			return false;
+		}
+		for (qpl::u64 i = 0u; i < count && file; ++i) {
+			qpl::u32 length = 0u;
+			read(length);
+			std::string name(length, '\0');
+			file.read(name.data(), length);
+
+			record record;
+			qpl::u8 directory = 0u;
+			read(directory);
+			record.directory = directory != 0u;
+			read(record.size);
+			read(record.time_a);
+			read(record.time_b);
+			read(record.hash);
+			this->records[name] = record;
+		}
+		return static_cast<bool>(file);
+	}
+	bool save(const std::filesystem::path& path) const {
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+		auto temporary = path;
+		temporary += ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				return false;
+			}
+			auto write = [&](const auto& value) {
+				file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+			};
+			write(magic);
+			write(static_cast<qpl::u64>(this->records.size()));
+			for (auto& [name, record] : this->records) {
+				write(static_cast<qpl::u32>(name.size()));
+				file.write(name.data(), name.size());
+				write(static_cast<qpl::u8>(record.directory));
+				write(record.size);
+				write(record.time_a);
+				write(record.time_b);
+				write(record.hash);
+			}
+			if (!file) {
+				return false;
+			}
+		}
+		std::filesystem::rename(temporary, path, error);
+		return !error;
+	}
+};
+
+//bidirectional, incremental directory synchronization.
+//a file counts as changed on one side when its size or write time differs from the manifest.
+//changes on one side are copied over, deletions are propagated, conflicts go to the newer file.
+struct synchronizer {
+	enum class action {
+		copy_a_to_b,
+		copy_b_to_a,
+		remove_a,
+		remove_b,
+	};
+	struct operation {
+		action type;
+		std::string name;
+	};
+
+	std::filesystem::path a;
+	std::filesystem::path b;
+	sync_options options;
+	copy_statistics* statistics = nullptr;
+	const std::atomic_bool* cancel = nullptr;
+
+	sync_manifest manifest;
+	std::map<std::string, sync_entry> entries_a;
+	std::map<std::string, sync_entry> entries_b;
+	std::vector<operation> operations;
+	std::vector<std::string> errors;
+
+	bool is_cancelled() const {
+		return this->cancel && this->cancel->load();
+	}
+	static qpl::i64 get_time(const std::filesystem::directory_entry& entry) {
+		std::error_code error;
+		return entry.last_write_time(error).time_since_epoch().count();
+	}
+	static qpl::u64 hash_file(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::vector<char> buffer(1u << 20);
+		auto hash = 0xCBF29CE484222325ull;
+		while (file) {
+			file.read(buffer.data(), buffer.size());
+			hash = sync_manifest::fnv1a(buffer.data(), static_cast<qpl::size>(file.gcount()), hash);
+		}
+		return hash;
+	}
+
+	void scan(const std::filesystem::path& root, std::map<std::string, sync_entry>& entries, bool side_a) {
+		std::error_code error;
+		std::vector<std::filesystem::path> directories = { root };
+		while (!directories.empty()) {
+			auto directory = std::move(directories.back());
+			directories.pop_back();
+
+			for (auto it = std::filesystem::directory_iterator(directory, error); !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+				auto name = std::filesystem::relative(it->path(), root, error).generic_string();
+				sync_entry entry;
+				entry.directory = it->is_directory(error);
+				entry.time = get_time(*it);
+				if (!entry.directory) {
+					entry.size = it->file_size(error);
+				}
+				entries[name] = entry;
+
+				if (!entry.directory) {
+					continue;
+				}
+				auto record = this->manifest.records.find(name);
+				bool unchanged = record != this->manifest.records.cend() && record->second.directory &&
+					(side_a ? record->second.time_a : record->second.time_b) == entry.time;
+
+				if (this->options.fast && unchanged) {
+					this->reuse_manifest(name, entries, side_a);
+				}
+				else {
+					directories.push_back(it->path());
+				}
+			}
+			if (error) {
+				this->errors.push_back(qpl::to_string("sync: couldn't read \"", directory.string(), "\": ", error.message()));
+				error.clear();
+			}
+		}
+	}
+	void reuse_manifest(const std::string& directory, std::map<std::string, sync_entry>& entries, bool side_a) {
+		auto prefix = directory + '/';
+		for (auto it = this->manifest.records.lower_bound(prefix); it != this->manifest.records.cend() && it->first.starts_with(prefix); ++it) {
+			sync_entry entry;
+			entry.directory = it->second.directory;
+			entry.size = it->second.size;
+			entry.time = side_a ? it->second.time_a : it->second.time_b;
+			entries[it->first] = entry;
+		}
+	}
+
+	bool changed(const std::string& name, const sync_entry& entry, bool side_a) const {
+		auto it = this->manifest.records.find(name);
+		if (it == this->manifest.records.cend()) {
+			return true;
+		}
+		auto& record = it->second;
+		if (record.directory != entry.directory) {
+			return true;
+		}
+		if (entry.directory) {
+			return false;
+		}
+		if (record.size != entry.size) {
+			return true;
+		}
+		if ((side_a ? record.time_a : record.time_b) == entry.time) {
+			return false;
+		}
+		if (this->options.hash && record.hash) {
+			return hash_file((side_a ? this->a : this->b) / name) != record.hash;
+		}
+		return true;
+	}
+
+	void plan() {
+		std::vector<std::string> names;
+		for (auto& i : this->entries_a) {
+			names.push_back(i.first);
+		}
+		for (auto& i : this->entries_b) {
+			if (!this->entries_a.contains(i.first)) {
+				names.push_back(i.first);
+			}
+		}
+
+		for (auto& name : names) {
+			auto a = this->entries_a.find(name);
+			auto b = this->entries_b.find(name);
+			bool in_a = a != this->entries_a.cend();
+			bool in_b = b != this->entries_b.cend();
+			bool known = this->manifest.records.contains(name);
+
+			if (in_a && in_b) {
+				if (a->second.directory || b->second.directory) {
+					continue;
+				}
+				bool changed_a = this->changed(name, a->second, true);
+				bool changed_b = this->changed(name, b->second, false);
+				if (!changed_a && !changed_b) {
+					continue;
+				}
+				if (a->second.size == b->second.size && a->second.time == b->second.time) {
+					continue;
+				}
+				if (changed_a && changed_b) {
+					if (this->options.hash && a->second.size == b->second.size && hash_file(this->a / name) == hash_file(this->b / name)) {
+						continue;
+					}
+					qpl::println(qpl::foreground::light_yellow, "sync conflict: ", name, " changed on both sides, keeping the newer one.");
+					this->operations.push_back({ a->second.time >= b->second.time ? action::copy_a_to_b : action::copy_b_to_a, name });
+				}
+				else {
+					this->operations.push_back({ changed_a ? action::copy_a_to_b : action::copy_b_to_a, name });
+				}
+			}
+			else if (in_a) {
+				if (known && !this->changed(name, a->second, true)) {
+					this->operations.push_back({ action::remove_a, name });
+				}
+				else if (!a->second.directory) {
+					this->operations.push_back({ action::copy_a_to_b, name });
+				}
+				else {
+					std::error_code error;
+					if (!this->options.dry_run) {
+						std::filesystem::create_directories(this->b / name, error);
+					}
+				}
+			}
+			else if (in_b) {
+				if (known && !this->changed(name, b->second, false)) {
+					this->operations.push_back({ action::remove_b, name });
+				}
+				else if (!b->second.directory) {
+					this->operations.push_back({ action::copy_b_to_a, name });
+				}
+				else {
+					std::error_code error;
+					if (!this->options.dry_run) {
+						std::filesystem::create_directories(this->a / name, error);
+					}
+				}
+			}
+		}
+	}
+
+	void print_plan() const {
+		for (auto& i : this->operations) {
+			switch (i.type) {
+			case action::copy_a_to_b:
+				qpl::println("sync: copy ", qpl::foreground::aqua, (this->a / i.name).string(), " to ", qpl::foreground::aqua, (this->b / i.name).string());
+				break;
+			case action::copy_b_to_a:
+				qpl::println("sync: copy ", qpl::foreground::aqua, (this->b / i.name).string(), " to ", qpl::foreground::aqua, (this->a / i.name).string());
+				break;
+			case action::remove_a:
+				qpl::println("sync: remove ", qpl::foreground::aqua, (this->a / i.name).string());
+				break;
+			case action::remove_b:
+				qpl::println("sync: remove ", qpl::foreground::aqua, (this->b / i.name).string());
+				break;
+			}
+		}
+	}
+
+	static bool stat(const std::filesystem::path& path, sync_entry& entry) {
+		std::error_code error;
+		std::filesystem::directory_entry file(path, error);
+		if (error || !file.exists(error)) {
+			return false;
+		}
+		entry.directory = file.is_directory(error);
+		entry.size = entry.directory ? 0u : file.file_size(error);
+		entry.time = get_time(file);
+		return !error;
+	}
+
+	void execute() {
+		copy_engine engine(this->statistics, this->cancel);
+		std::vector<std::unique_ptr<copy_engine::file_task>> files;
+		std::vector<std::filesystem::path> removals;
+		std::vector<std::filesystem::path> directory_removals;
+
+		//only now, after planning, a missing root is created as a copy target
+		std::error_code error;
+		std::filesystem::create_directories(this->a, error);
+		std::filesystem::create_directories(this->b, error);
+		for (auto& i : this->operations) {
+			switch (i.type) {
+			case action::copy_a_to_b:
+				std::filesystem::create_directories((this->b / i.name).parent_path(), error);
+				engine.add_file(files, this->a / i.name, this->b / i.name);
+				break;
+			case action::copy_b_to_a:
+				std::filesystem::create_directories((this->a / i.name).parent_path(), error);
+				engine.add_file(files, this->b / i.name, this->a / i.name);
+				break;
+			case action::remove_a:
+			case action::remove_b: {
+				auto& entries = i.type == action::remove_a ? this->entries_a : this->entries_b;
+				auto path = (i.type == action::remove_a ? this->a : this->b) / i.name;
+				if (entries[i.name].directory) {
+					directory_removals.push_back(path);
+				}
+				else {
+					removals.push_back(path);
+				}
+			} break;
+			}
+		}
+		engine.copy_files(files);
+		this->errors.insert(this->errors.end(), engine.errors.begin(), engine.errors.end());
+
+		for (auto& path : removals) {
+			if (this->is_cancelled()) {
+				return;
+			}
+			std::filesystem::remove(path, error);
+			if (error) {
+				this->errors.push_back(qpl::to_string("sync: couldn't remove \"", path.string(), "\": ", error.message()));
+				error.clear();
+			}
+		}
+
+		//deepest first, directories that still hold changed files stay
+		std::ranges::sort(directory_removals, [](const auto& a, const auto& b) {
+			return a.native().size() > b.native().size();
+		});
+		for (auto& path : directory_removals) {
+			std::filesystem::remove(path, error);
+			error.clear();
+		}
+	}
+
+	void update_manifest() {
+		auto previous = std::move(this->manifest.records);
+		this->manifest.records.clear();
+
+		std::unordered_map<std::string, action> actions;
+		for (auto& i : this->operations) {
+			actions[i.name] = i.type;
+		}
+		auto add = [&](const std::string& name) {
+			if (this->manifest.records.contains(name)) {
+				return;
+			}
+			sync_entry a;
+			sync_entry b;
+			auto it = actions.find(name);
+			if (it != actions.cend() && (it->second == action::remove_a || it->second == action::remove_b)) {
+				return;
+			}
+			if (it != actions.cend() && it->second == action::copy_a_to_b) {
+				a = this->entries_a[name];
+				if (!stat(this->b / name, b)) {
+					return;
+				}
+			}
+			else if (it != actions.cend() && it->second == action::copy_b_to_a) {
+				b = this->entries_b[name];
+				if (!stat(this->a / name, a)) {
+					return;
+				}
+			}
+			else {
+				auto found_a = this->entries_a.find(name);
+				auto found_b = this->entries_b.find(name);
+				if (found_a != this->entries_a.cend()) {
+					a = found_a->second;
+				}
+				else if (!stat(this->a / name, a)) {
+					return;
+				}
+				if (found_b != this->entries_b.cend()) {
+					b = found_b->second;
+				}
+				else if (!stat(this->b / name, b)) {
+					return;
+				}
+			}
+
+			sync_manifest::record record;
+			record.directory = a.directory;
+			record.size = a.size;
+			record.time_a = a.time;
+			record.time_b = b.time;
+			if (this->options.hash && !a.directory) {
+				auto old = previous.find(name);
+				bool same = old != previous.cend() && old->second.hash && old->second.size == a.size && old->second.time_a == a.time;
+				record.hash = same ? old->second.hash : hash_file(this->a / name);
+			}
+			this->manifest.records[name] = record;
+		};
+		for (auto& i : this->entries_a) {
+			add(i.first);
+		}
+		for (auto& i : this->entries_b) {
+			add(i.first);
+		}
+	}
+
+	static bool is_missing_or_empty(const std::filesystem::path& root) {
+		std::error_code error;
+		if (!std::filesystem::is_directory(root, error)) {
+			return true;
+		}
+		return std::filesystem::directory_iterator(root, error) == std::filesystem::directory_iterator();
+	}
+
+	//a missing or empty root (an unmounted drive, a typo) would look like every file was deleted on that side.
+	//with a manifest that would delete the other side too, so such a run starts over as a first sync instead.
+	//the same goes for a directory that couldn't be read, so nothing is planned after a scan error
+	bool run() {
+		auto manifest_path = sync_manifest::get_path(this->a, this->b);
+		this->manifest.load(manifest_path);
+
+		bool missing_a = is_missing_or_empty(this->a);
+		bool missing_b = is_missing_or_empty(this->b);
+		std::error_code error;
+		if (!std::filesystem::is_directory(this->a, error) && !std::filesystem::is_directory(this->b, error)) {
+			this->errors.push_back(qpl::to_string("sync: neither \"", this->a.string(), "\" nor \"", this->b.string(), "\" exists."));
+			return false;
+		}
+		if ((missing_a || missing_b) && !this->manifest.records.empty()) {
+			qpl::println(qpl::foreground::light_yellow, "sync: \"", (missing_a ? this->a : this->b).string(), "\" is missing or empty, nothing gets removed, it's synchronized like the first time.");
+			this->manifest.records.clear();
+		}
+
+		if (!missing_a) {
+			this->scan(this->a, this->entries_a, true);
+		}
+		if (!missing_b) {
+			this->scan(this->b, this->entries_b, false);
+		}
+		if (this->is_cancelled()) {
+			return false;
+		}
+		if (!this->errors.empty()) {
+			this->errors.push_back(qpl::to_string("sync: \"", this->a.string(), "\" and \"", this->b.string(), "\" weren't synchronized, nothing was changed."));
+			return false;
+		}
+		this->plan();
+
+		if (this->operations.empty()) {
+			qpl::println(qpl::foreground::aqua, this->a.string(), " and ", qpl::foreground::aqua, this->b.string(), " are synchronized already.");
+		}
+		if (this->options.dry_run) {
+			qpl::println("sync (dry run): ", this->operations.size(), " operations planned.");
+			this->print_plan();
+			return this->errors.empty();
+		}
+		this->print_plan();
+		this->execute();
+		if (this->is_cancelled() || !this->errors.empty()) {
+			return false;
+		}
+		this->update_manifest();
+		if (!this->manifest.save(manifest_path)) {
+			this->errors.push_back(qpl::to_string("sync: couldn't write manifest \"", manifest_path.string(), "\"."));
+		}
+		return this->errors.empty();
+	}
+};
@@ -0,0 +1,257 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <memory>
+#include <string>
+
+//immutable, line indexed text: a persistent treap whose nodes hold one line each.
+//edits copy only the O(log n) nodes on the path, so a copy of the rope is an O(1) snapshot
+//that keeps sharing every untouched line with the original
+struct text_rope {
+	struct node {
+		std::shared_ptr<const node> left;
+		std::shared_ptr<const node> right;
+		std::shared_ptr<const std::wstring> line;
+		qpl::u32 priority = 0u;
+		qpl::size count = 1u;
+		qpl::size characters = 0u;
+	};
+	using node_ptr = std::shared_ptr<const node>;
+
+	node_ptr root;
+
+	static qpl::u32 next_priority() {
+		static thread_local qpl::u32 state = 0x9E3779B9u;
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+	static qpl::size count(const node_ptr& node) {
+		return node ? node->count : 0u;
+	}
+	static qpl::size characters(const node_ptr& node) {
+		return node ? node->characters : 0u;
+	}
+	static node_ptr make(node_ptr left, node_ptr right, std::shared_ptr<const std::wstring> line, qpl::u32 priority) {
+		auto result = std::make_shared<node>();
+		result->count = count(left) + count(right) + 1u;
+		result->characters = characters(left) + characters(right) + line->size();
+		result->left = std::move(left);
+		result->right = std::move(right);
+		result->line = std::move(line);
+		result->priority = priority;
+		return result;
+	}
+	static node_ptr merge(const node_ptr& a, const node_ptr& b) {
+		if (!a) {
+			return b;
+		}
+		if (!b) {
+			return a;
+		}
+		if (a->priority > b->priority) {
+			return make(a->left, merge(a->right, b), a->line, a->priority);
+		}
+		return make(merge(a, b->left), b->right, b->line, b->priority);
+	}
+	//first holds the first index lines, second the rest
+	static std::pair<node_ptr, node_ptr> split(const node_ptr& node, qpl::size index) {
+		if (!node) {
+			return {};
+		}
+		if (index <= count(node->left)) {
+			auto [left, right] = split(node->left, index);
+			return { left, make(right, node->right, node->line, node->priority) };
+		}
+		auto [left, right] = split(node->right, index - count(node->left) - 1u);
+		return { make(node->left, left, node->line, node->priority), right };
+	}
+	//builds a subtree from lines in order in O(n). nodes are linked along the right spine like a cartesian tree,
+	//a node's subtree is complete once it's popped off the spine, its sizes are summed up right then
+	template<typename It>
+	static node_ptr build(It begin, It end) {
+		std::vector<std::shared_ptr<node>> spine;
+		auto finish = [](node& node) {
+			node.count = count(node.left) + count(node.right) + 1u;
+			node.characters = characters(node.left) + characters(node.right) + node.line->size();
+		};
+		for (auto it = begin; it != end; ++it) {
+			auto current = std::make_shared<node>();
+			current->line = std::make_shared<const std::wstring>(*it);
+			current->priority = next_priority();
+			std::shared_ptr<node> last;
+			while (!spine.empty() && spine.back()->priority < current->priority) {
+				last = std::move(spine.back());
+				spine.pop_back();
+				finish(*last);
+			}
+			current->left = std::move(last);
+			if (!spine.empty()) {
+				spine.back()->right = current;
+			}
+			spine.push_back(std::move(current));
+		}
+		if (spine.empty()) {
+			return nullptr;
+		}
+		while (spine.size() > 1u) {
+			finish(*spine.back());
+			spine.pop_back();
+		}
+		finish(*spine.front());
+		return spine.front();
+	}
+
+	static std::vector<std::wstring> split_lines(std::wstring_view text) {
+		std::vector<std::wstring> result;
+		qpl::size begin = 0u;
+		while (true) {
+			auto end = text.find(L'\n', begin);
+			result.emplace_back(text.substr(begin, end == std::wstring_view::npos ? std::wstring_view::npos : end - begin));
+			if (end == std::wstring_view::npos) {
+				return result;
+			}
+			begin = end + 1;
+		}
+	}
+
+	qpl::size size() const {
+		return count(this->root);
+	}
+	bool empty() const {
+		return !this->root;
+	}
+	//characters including the line breaks
+	qpl::size length() const {
+		return this->root ? characters(this->root) + this->size() - 1u : 0u;
+	}
+	const std::wstring& line(qpl::size index) const {
+		auto node = this->root.get();
+		while (true) {
+			auto left = count(node->left);
+			if (index < left) {
+				node = node->left.get();
+			}
+			else if (index == left) {
+				return *node->line;
+			}
+			else {
+				index -= left + 1u;
+				node = node->right.get();
+			}
+		}
+	}
+	//replaces count lines at index with the given lines
+	void replace(qpl::size index, qpl::size count, const std::vector<std::wstring>& lines) {
+		auto [left, rest] = split(this->root, index);
+		auto [removed, right] = split(rest, count);
+		this->root = merge(merge(left, build(lines.cbegin(), lines.cend())), right);
+	}
+	void assign(std::wstring_view text) {
+		auto lines = split_lines(text);
+		this->root = build(lines.cbegin(), lines.cend());
+	}
+
+	template<typename F>
+	static void for_each(const node* node, F& function) {
+		while (node) {
+			for_each(node->left.get(), function);
+			function(*node->line);
+			node = node->right.get();
+		}
+	}
+	template<typename F>
+	void for_each_line(F&& function) const {
+		for_each(this->root.get(), function);
+	}
+	std::wstring wstring() const {
+		std::wstring result;
+		result.reserve(this->length());
+		bool first = true;
+		this->for_each_line([&](const std::wstring& line) {
+			if (!first) {
+				result.push_back(L'\n');
+			}
+			result.append(line);
+			first = false;
+		});
+		return result;
+	}
+
+	struct line_change {
+		qpl::size index = 0u;
+		qpl::size removed = 0u;
+		qpl::size inserted = 0u;
+	};
+	//brings the rope in line with text and reports which line range changed.
+	//lines are compared from both ends, only the differing middle is rebuilt
+	line_change update(std::wstring_view text) {
+		line_change change;
+		auto size = this->size();
+		if (!size) {
+			this->assign(text);
+			change.inserted = this->size();
+			return change;
+		}
+
+		qpl::size front = 0u;
+		qpl::size position = 0u;
+		while (front < size) {
+			auto end = text.find(L'\n', position);
+			auto line = text.substr(position, end == std::wstring_view::npos ? std::wstring_view::npos : end - position);
+			if (end == std::wstring_view::npos || line != this->line(front)) {
+				break;
+			}
+			position = end + 1;
+			++front;
+		}
+
+		qpl::size back = 0u;
+		auto end_position = text.size();
+		while (back + front < size && end_position) {
+			auto begin = text.rfind(L'\n', end_position - 1);
+			if (begin == std::wstring_view::npos || begin + 1 < position) {
+				break;
+			}
+			auto line = text.substr(begin + 1, end_position - begin - 1);
+			if (line != this->line(size - 1u - back)) {
+				break;
+			}
+			end_position = begin;
+			++back;
+		}
+
+		//the suffix may start right after the prefix, then no line is inserted in between
+		std::vector<std::wstring> lines;
+		if (end_position + 1 != position) {
+			lines = split_lines(text.substr(position, end_position - position));
+		}
+		change.index = front;
+		change.removed = size - front - back;
+		change.inserted = lines.size();
+		this->replace(change.index, change.removed, lines);
+		return change;
+	}
+	//line range in which other differs from this rope. versions of one rope share their untouched lines,
+	//so most lines are told apart by address before their characters are compared
+	line_change compare(const text_rope& other) const {
+		auto same = [](const std::wstring& a, const std::wstring& b) {
+			return &a == &b || a == b;
+		};
+		auto size = this->size();
+		auto other_size = other.size();
+		qpl::size front = 0u;
+		while (front < size && front < other_size && same(this->line(front), other.line(front))) {
+			++front;
+		}
+		qpl::size back = 0u;
+		while (back + front < size && back + front < other_size && same(this->line(size - 1u - back), other.line(other_size - 1u - back))) {
+			++back;
+		}
+		line_change change;
+		change.index = front;
+		change.removed = size - front - back;
+		change.inserted = other_size - front - back;
+		return change;
+	}
+};
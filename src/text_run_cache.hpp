@@ -0,0 +1,129 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <unordered_map>
+#include "profiler.hpp"
+#include "config.hpp"
+
+//glyph quads of one laid out line of text, positioned relative to the line origin.
+//texture coordinates point into the glyph atlas sfml keeps per font and character size
+struct text_run {
+	std::vector<sf::Vertex> vertices;
+	qpl::f32 width = 0.f;
+};
+
+//laid out lines shared by every widget showing the same line in the same font and size.
+//runs are held weakly, they go away once no widget displays them anymore
+struct text_run_cache {
+	struct font_runs {
+		std::string font;
+		qpl::u32 character_size = 0u;
+		std::unordered_map<std::wstring, std::weak_ptr<const text_run>> runs;
+	};
+	std::vector<font_runs> fonts;
+	qpl::size insertions = 0u;
+
+	static text_run layout(const sf::Font& font, qpl::u32 character_size, const std::wstring& line, qpl::rgb color) {
+		text_run run;
+		run.vertices.reserve(line.size() * 6u);
+
+		auto space = font.getGlyph(L' ', character_size, false).advance;
+		qpl::f32 x = 0.f;
+		auto baseline = static_cast<qpl::f32>(character_size);
+		std::uint32_t previous = 0u;
+		for (auto& c : line) {
+			auto code = static_cast<std::uint32_t>(c);
+			x += font.getKerning(previous, code, character_size);
+			previous = code;
+			if (c == L' ') {
+				x += space;
+				continue;
+			}
+			if (c == L'\t') {
+				x += space * 4;
+				continue;
+			}
+
+			auto& glyph = font.getGlyph(code, character_size, false);
+			auto left = x + glyph.bounds.left;
+			auto top = baseline + glyph.bounds.top;
+			auto right = left + glyph.bounds.width;
+			auto bottom = top + glyph.bounds.height;
+			auto u1 = static_cast<qpl::f32>(glyph.textureRect.left);
+			auto v1 = static_cast<qpl::f32>(glyph.textureRect.top);
+			auto u2 = u1 + glyph.textureRect.width;
+			auto v2 = v1 + glyph.textureRect.height;
+
+			std::array<sf::Vertex, 4u> corners;
+			corners[0].position = qpl::vec(left, top);
+			corners[0].texCoords = qpl::vec(u1, v1);
+			corners[1].position = qpl::vec(right, top);
+			corners[1].texCoords = qpl::vec(u2, v1);
+			corners[2].position = qpl::vec(right, bottom);
+			corners[2].texCoords = qpl::vec(u2, v2);
+			corners[3].position = qpl::vec(left, bottom);
+			corners[3].texCoords = qpl::vec(u1, v2);
+			constexpr std::array<qpl::size, 6u> triangles = { 0, 1, 2, 0, 2, 3 };
+			for (auto& i : triangles) {
+				run.vertices.push_back(corners[i]);
+				run.vertices.back().color = color;
+			}
+			x += glyph.advance;
+		}
+		run.width = x;
+		return run;
+	}
+
+	std::shared_ptr<const text_run> get(const std::string& font, qpl::u32 character_size, const std::wstring& line) {
+		auto it = std::ranges::find_if(this->fonts, [&](const font_runs& runs) {
+			return runs.font == font && runs.character_size == character_size;
+		});
+		if (it == this->fonts.end()) {
+			this->fonts.push_back({ font, character_size, {} });
+			it = this->fonts.end() - 1;
+		}
+		auto& slot = it->runs[line];
+		if (auto run = slot.lock()) {
+			return run;
+		}
+		auto run = std::make_shared<const text_run>(layout(qsf::get_font(font), character_size, line, config::widget_text_color));
+		slot = run;
+
+		if (++this->insertions >= config::text_run_cache_purge_interval) {
+			this->purge();
+		}
+		return run;
+	}
+	void purge() {
+		for (auto& font : this->fonts) {
+			std::erase_if(font.runs, [](const auto& entry) {
+				return entry.second.expired();
+			});
+		}
+		this->insertions = 0u;
+	}
+};
+
+inline text_run_cache& get_text_run_cache() {
+	static text_run_cache cache;
+	return cache;
+}
+
+//draws a block of cached lines with the font atlas of their size
+struct text_runs_drawable : sf::Drawable {
+	const std::vector<std::shared_ptr<const text_run>>* runs = nullptr;
+	const sf::Texture* texture = nullptr;
+	qpl::vec2 position;
+	qpl::f32 line_spacing = 0.f;
+
+	void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
+		states.texture = this->texture;
+		states.transform.translate(this->position);
+		for (auto& run : *this->runs) {
+			if (!run->vertices.empty()) {
+				target.draw(run->vertices.data(), run->vertices.size(), sf::PrimitiveType::Triangles, states);
+				get_profiler().count(profile_counter::draw_calls);
+			}
+			states.transform.translate(0.f, this->line_spacing);
+		}
+	}
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include "widget.hpp"
+#include "widget_handle.hpp"
+#include "config.hpp"
+
+enum class undo_type {
+	create,
+	remove,
+	move,
+	text,
+};
+
+//one reversible edit. moves keep only their delta, text edits keep the rope before and after, which share
+//every untouched line with each other and the widget. created and removed widgets keep their record
+struct undo_entry {
+	undo_type type = undo_type::move;
+	widget_handle handle;
+	qpl::vec2 delta;
+	text_rope before;
+	text_rope after;
+	//the lines of before that after replaced
+	text_rope::line_change change;
+	//the removed widget, for a creation it's taken when the creation is undone
+	std::shared_ptr<const widget_record> record;
+	std::chrono::steady_clock::time_point time;
+	qpl::size bytes = 0u;
+	//a sealed entry doesn't absorb the following edits anymore
+	bool sealed = false;
+
+	static qpl::size line_bytes(const text_rope& text, qpl::size index, qpl::size count) {
+		qpl::size result = count * sizeof(text_rope::node);
+		for (qpl::size i = 0u; i < count; ++i) {
+			result += text.line(index + i).size() * sizeof(wchar_t);
+		}
+		return result;
+	}
+	//what the entry keeps alive on its own: lines shared with the board or other entries aren't counted
+	void update_bytes() {
+		this->bytes = sizeof(undo_entry);
+		if (this->type == undo_type::text) {
+			auto& change = this->change;
+			this->bytes += line_bytes(this->before, change.index, change.removed) + line_bytes(this->after, change.index, change.inserted);
+			//the copied path from the root down to the changed lines
+			this->bytes += 2u * static_cast<qpl::size>(std::log2(this->before.size() + this->after.size() + 2u)) * sizeof(text_rope::node);
+		}
+		if (this->record) {
+			this->bytes += sizeof(widget_record) + line_bytes(this->record->text, 0u, this->record->text.size());
+		}
+	}
+};
+
+//linear undo history, entries before the cursor can be undone and the ones after it redone.
+//a new edit drops the redo tail, the oldest entries are dropped once config::undo_memory_limit is exceeded.
+//a continuous drag is one move and typing into the same widget is one text edit until it pauses for
+//config::undo_coalesce_time seconds
+struct undo_log {
+	std::deque<undo_entry> entries;
+	qpl::size cursor = 0u;
+	qpl::size bytes = 0u;
+
+	void clear() {
+		this->entries.clear();
+		this->cursor = 0u;
+		this->bytes = 0u;
+	}
+	bool can_undo() const {
+		return this->cursor > 0u;
+	}
+	bool can_redo() const {
+		return this->cursor < this->entries.size();
+	}
+	qpl::size size() const {
+		return this->entries.size();
+	}
+
+	void push(undo_entry&& entry) {
+		while (this->entries.size() > this->cursor) {
+			this->bytes -= this->entries.back().bytes;
+			this->entries.pop_back();
+		}
+		entry.time = std::chrono::steady_clock::now();
+		if (this->coalesce(entry)) {
+			return;
+		}
+		entry.update_bytes();
+		this->bytes += entry.bytes;
+		this->entries.push_back(std::move(entry));
+		this->cursor = this->entries.size();
+		this->trim();
+	}
+	void push_text(widget_handle handle, const text_rope& before, const text_rope& after, text_rope::line_change change) {
+		undo_entry entry;
+		entry.type = undo_type::text;
+		entry.handle = handle;
+		entry.before = before;
+		entry.after = after;
+		entry.change = change;
+		this->push(std::move(entry));
+	}
+	void push_move(widget_handle handle, qpl::vec2 delta) {
+		undo_entry entry;
+		entry.type = undo_type::move;
+		entry.handle = handle;
+		entry.delta = delta;
+		entry.sealed = true;
+		this->push(std::move(entry));
+	}
+	void push_create(widget_handle handle) {
+		undo_entry entry;
+		entry.type = undo_type::create;
+		entry.handle = handle;
+		entry.sealed = true;
+		this->push(std::move(entry));
+	}
+	void push_remove(widget_handle handle, std::shared_ptr<const widget_record> record) {
+		undo_entry entry;
+		entry.type = undo_type::remove;
+		entry.handle = handle;
+		entry.record = std::move(record);
+		entry.sealed = true;
+		this->push(std::move(entry));
+	}
+
+	//the returned entry is applied by the caller, which may swap its record
+	undo_entry* undo() {
+		if (!this->can_undo()) {
+			return nullptr;
+		}
+		--this->cursor;
+		this->entries[this->cursor].sealed = true;
+		return &this->entries[this->cursor];
+	}
+	undo_entry* redo() {
+		if (!this->can_redo()) {
+			return nullptr;
+		}
+		return &this->entries[this->cursor++];
+	}
+	//after the caller changed an entry's record
+	void update_bytes(undo_entry& entry) {
+		this->bytes -= entry.bytes;
+		entry.update_bytes();
+		this->bytes += entry.bytes;
+		this->trim();
+	}
+	//a widget brought back by undo or redo has a new handle, older and newer entries follow it
+	void remap(widget_handle from, widget_handle to) {
+		for (auto& entry : this->entries) {
+			if (entry.handle == from) {
+				entry.handle = to;
+			}
+		}
+	}
+
+private:
+	bool coalesce(const undo_entry& entry) {
+		if (entry.type != undo_type::text || this->entries.empty()) {
+			return false;
+		}
+		auto& last = this->entries.back();
+		auto idle = std::chrono::duration<qpl::f64>(entry.time - last.time).count();
+		if (last.sealed || last.type != entry.type || last.handle != entry.handle || idle > config::undo_coalesce_time) {
+			return false;
+		}
+		last.after = entry.after;
+		last.change = combine(last.change, entry.change);
+		last.time = entry.time;
+		this->update_bytes(last);
+		return true;
+	}
+	//first changed a into b, second b into c. the result is the range of a that c replaced,
+	//lines outside of both ranges are the same in all three
+	static text_rope::line_change combine(text_rope::line_change first, text_rope::line_change second) {
+		auto begin = std::min(first.index, second.index);
+		auto end = std::max(first.index + first.inserted, second.index + second.removed);
+		text_rope::line_change result;
+		result.index = begin;
+		result.removed = end - begin - first.inserted + first.removed;
+		result.inserted = end - begin - second.removed + second.inserted;
+		return result;
+	}
+	//the newest entry is always kept, even if it alone is over the limit
+	void trim() {
+		while (this->bytes > config::undo_memory_limit && this->entries.size() > 1u && this->cursor > 0u) {
+			this->bytes -= this->entries.front().bytes;
+			this->entries.pop_front();
+			--this->cursor;
+		}
+	}
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <string>
+#include <string_view>
+#include "text_rope.hpp"
+
+namespace utf8 {
+	inline std::string encode(const std::wstring& string) {
+		std::string result;
+		result.reserve(string.size());
+		for (qpl::size i = 0u; i < string.size(); ++i) {
+			auto code = static_cast<qpl::u32>(string[i]);
+			if constexpr (sizeof(wchar_t) == 2u) {
+				if (code >= 0xD800u && code < 0xDC00u && i + 1 < string.size()) {
+					auto low = static_cast<qpl::u32>(string[i + 1]);
+					if (low >= 0xDC00u && low < 0xE000u) {
+						code = 0x10000u + ((code - 0xD800u) << 10) + (low - 0xDC00u);
+						++i;
+					}
+				}
+			}
+			if (code < 0x80u) {
+				result.push_back(static_cast<char>(code));
+			}
+			else if (code < 0x800u) {
+				result.push_back(static_cast<char>(0xC0u | (code >> 6)));
+				result.push_back(static_cast<char>(0x80u | (code & 0x3Fu)));
+			}
+			else if (code < 0x10000u) {
+				result.push_back(static_cast<char>(0xE0u | (code >> 12)));
+				result.push_back(static_cast<char>(0x80u | ((code >> 6) & 0x3Fu)));
+				result.push_back(static_cast<char>(0x80u | (code & 0x3Fu)));
+			}
+			else {
+				result.push_back(static_cast<char>(0xF0u | (code >> 18)));
+				result.push_back(static_cast<char>(0x80u | ((code >> 12) & 0x3Fu)));
+				result.push_back(static_cast<char>(0x80u | ((code >> 6) & 0x3Fu)));
+				result.push_back(static_cast<char>(0x80u | (code & 0x3Fu)));
+			}
+		}
+		return result;
+	}
+	inline std::string encode(const text_rope& text) {
+		std::string result;
+		result.reserve(text.length());
+		bool first = true;
+		text.for_each_line([&](const std::wstring& line) {
+			if (!first) {
+				result.push_back('\n');
+			}
+			result.append(encode(line));
+			first = false;
+		});
+		return result;
+	}
+	inline std::wstring decode(std::string_view string) {
+		std::wstring result;
+		result.reserve(string.size());
+		for (qpl::size i = 0u; i < string.size();) {
+			auto byte = static_cast<qpl::u8>(string[i]);
+			qpl::size length = byte < 0x80u ? 1u : byte < 0xE0u ? 2u : byte < 0xF0u ? 3u : 4u;
+			if (i + length > string.size()) {
+				break;
+			}
+			qpl::u32 code = length == 1u ? byte : length == 2u ? (byte & 0x1Fu) : length == 3u ? (byte & 0x0Fu) : (byte & 0x07u);
+			for (qpl::size j = 1u; j < length; ++j) {
+				code = (code << 6) | (static_cast<qpl::u8>(string[i + j]) & 0x3Fu);
+			}
+			i += length;
+
+			if (sizeof(wchar_t) == 2u && code >= 0x10000u) {
+				code -= 0x10000u;
+				result.push_back(static_cast<wchar_t>(0xD800u + (code >> 10)));
+				result.push_back(static_cast<wchar_t>(0xDC00u + (code & 0x3FFu)));
+			}
+			else {
+				result.push_back(static_cast<wchar_t>(code));
+			}
+		}
+		return result;
+	}
+}
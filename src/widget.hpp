@@ -1,31 +1,229 @@
 #pragma once
 #include <qpl/qpl.hpp>
 #include "executable_script.hpp"
+#include "text_run_cache.hpp"
+#include "text_rope.hpp"
+#include "object_pool.hpp"
+#include "profiler.hpp"
 
 enum class widget_type {
 	text,
 	executable_script,
 };
 
+//changes since the last save, consumed by the session journal
+namespace widget_changes {
+	constexpr qpl::u8 created = 1u << 0;
+	constexpr qpl::u8 moved = 1u << 1;
+	constexpr qpl::u8 text = 1u << 2;
+	constexpr qpl::u8 raised = 1u << 3;
+}
+
+//immutable copy of the persisted widget state, shared between saves until the widget changes
+struct widget_record {
+	text_rope text;
+	qpl::vec2 position;
+	qpl::vec2 scale;
+	widget_type type = widget_type::text;
+
+	void save(qpl::save_state& state) const {
+		state.save(this->text.wstring());
+		state.save(this->position);
+		state.save(this->scale);
+		state.save(this->type);
+	}
+	bool load(qpl::load_state& state) {
+		std::wstring text;
+		state.load(text);
+		this->text.assign(text);
+		state.load(this->position);
+		state.load(this->scale);
+		state.load(this->type);
+		return true;
+	}
+};
+
 struct widget {
 	qsf::view view;
-	qsf::text_field text;
-	qsf::smooth_rectangle background;
+	//only exists while the widget is being edited, otherwise the text lives in lines and is drawn from text_runs
+	std::unique_ptr<qsf::text_field> text;
 	qpl::hitbox dragging_hitbox;
 	qpl::hitbox hitbox;
+	//local space area of the text field background, measured from the laid out lines
+	qpl::hitbox text_hitbox;
 	widget_type type = widget_type::text;
-
-	std::unique_ptr<executable_script> executable_script;
+	qpl::u64 id = 0u;
+	qpl::u8 changes = 0u;
+	//index into the session archive while the widget isn't materialized yet
+	qpl::size archive_index = qpl::size_max;
+
+	pool_ptr<::executable_script> executable_script;
+	std::shared_ptr<const widget_record> record;
+
+	//shared layout of every line, used to draw the text while the text field isn't being edited
+	std::string font = "helvetica";
+	std::vector<std::shared_ptr<const text_run>> text_runs;
+	//the widget text, shared with saves, the undo history and the script compiler
+	text_rope lines;
+	bool text_runs_valid = false;
+	//bumped whenever the text pass would look different, cached renders of it compare this
+	qpl::u64 text_version = 0u;
 
 	bool first_update = true;
 	bool hovering = false;
 	bool dragging = false;
 	bool just_selected = false;
+	bool just_edited = false;
+	//the lines the last edit replaced, only meaningful while just_edited is set
+	text_rope::line_change edited_lines;
+	bool hitbox_changed = true;
+	bool geometry_changed = true;
 
 	constexpr static qpl::rgb background_color = qpl::rgb::grey_shade(100);
+	inline static const qpl::vec2 text_position = qpl::vec(40, 70);
+	inline static const qpl::vec2 text_background_increase = qpl::vec(20, 20);
+	qpl::rgb color = background_color;
+
+	//world space results of the view transform, only recomputed after the widget moved, got a new layout or scale
+	mutable qpl::vec2 transform_origin;
+	mutable qpl::vec2 transform_scale;
+	mutable qpl::hitbox world_hitbox;
+	mutable qpl::hitbox world_bounds;
+	mutable qpl::hitbox world_dragging_hitbox;
+	mutable bool transform_dirty = true;
+
+	void update_transform() const {
+		if (!this->transform_dirty) {
+			return;
+		}
+		//the view transform is axis aligned, so the unit box gives its offset and scale
+		qpl::hitbox unit;
+		unit.position = qpl::vec(0, 0);
+		unit.dimension = qpl::vec(1, 1);
+		unit = this->view.transform_hitbox(unit);
+		this->transform_origin = unit.position;
+		this->transform_scale = unit.dimension;
+		this->transform_dirty = false;
+
+		auto bounds = this->hitbox;
+		if (this->executable_script) {
+			auto script = this->executable_script->get_hitbox().extended_up(60);
+			auto top_left = qpl::vec(std::min(bounds.position.x, script.position.x), std::min(bounds.position.y, script.position.y));
+			auto bottom_right = qpl::vec(
+				std::max(bounds.position.x + bounds.dimension.x, script.position.x + script.dimension.x),
+				std::max(bounds.position.y + bounds.dimension.y, script.position.y + script.dimension.y)
+			);
+			bounds.position = top_left;
+			bounds.dimension = bottom_right - top_left;
+		}
+		this->world_hitbox = this->transform_hitbox(this->hitbox);
+		this->world_bounds = this->transform_hitbox(bounds);
+		this->world_dragging_hitbox = this->transform_hitbox(this->dragging_hitbox);
+	}
+	void invalidate_transform() {
+		this->transform_dirty = true;
+		this->hitbox_changed = true;
+		this->geometry_changed = true;
+	}
 
-	qpl::hitbox get_hitbox() const {
-		return this->view.transform_hitbox(this->hitbox);
+	const qpl::hitbox& get_hitbox() const {
+		this->update_transform();
+		return this->world_hitbox;
+	}
+	//world space hitbox including the executable script chrome below the widget
+	const qpl::hitbox& get_bounds() const {
+		this->update_transform();
+		return this->world_bounds;
+	}
+	const qpl::hitbox& get_dragging_hitbox() const {
+		this->update_transform();
+		return this->world_dragging_hitbox;
+	}
+	//world units per local unit of the widget
+	qpl::f32 get_world_scale() const {
+		this->update_transform();
+		return this->transform_scale.x;
+	}
+	bool is_animating() const {
+		return this->executable_script && (this->executable_script->checkmark_hovering_animation.is_running() || this->executable_script->is_job_active() || this->executable_script->has_new_watch_job());
+	}
+	qpl::hitbox transform_hitbox(qpl::hitbox hitbox) const {
+		this->update_transform();
+		hitbox.position = this->transform_origin + hitbox.position * this->transform_scale;
+		hitbox.dimension = hitbox.dimension * this->transform_scale;
+		return hitbox;
+	}
+	qpl::vec2 transform_point(qpl::vec2 position) const {
+		this->update_transform();
+		return this->transform_origin + position * this->transform_scale;
+	}
+	bool take_geometry_changed() {
+		bool result = this->geometry_changed;
+		this->geometry_changed = false;
+		if (this->executable_script && this->executable_script->geometry_changed) {
+			this->executable_script->geometry_changed = false;
+			result = true;
+		}
+		return result;
+	}
+	const std::shared_ptr<const widget_record>& get_record() {
+		constexpr auto persisted = widget_changes::created | widget_changes::moved | widget_changes::text;
+		if (!this->record || (this->changes & persisted)) {
+			auto record = std::make_shared<widget_record>();
+			record->text = this->lines;
+			record->position = this->view.position;
+			record->scale = this->view.scale;
+			record->type = this->type;
+			this->record = std::move(record);
+		}
+		return this->record;
+	}
+
+	bool is_editing() const {
+		return this->text != nullptr;
+	}
+	//creates the text field from the lines, it takes the click that started the edit
+	void begin_editing() {
+		this->text = std::make_unique<qsf::text_field>();
+		this->text->set_font(this->font);
+		this->text->set_text_character_size(static_cast<qpl::u32>(config::widget_text_character_size));
+		this->text->background_increase = text_background_increase;
+		this->text->background.set_color(config::widget_text_background_color);
+		this->text->background.set_outline_thickness(5.0f);
+		this->text->background.set_outline_color(qpl::rgb::black());
+		this->text->background.set_slope_dimension(config::widget_slope_dimension);
+		this->text->set_position(text_position);
+		this->text->set_string(this->lines.wstring());
+		this->text->set_focus(true);
+	}
+	//the lines are already up to date with the text field, its layout isn't needed anymore
+	void end_editing() {
+		this->text.reset();
+		if (this->executable_script) {
+			this->executable_script->print_syntax_errors();
+		}
+	}
+	//copy that shares text, layout, rope, compiled script and its watch with this widget
+	widget clone() const {
+		widget result;
+		result.dragging_hitbox = this->dragging_hitbox;
+		result.hitbox = this->hitbox;
+		result.text_hitbox = this->text_hitbox;
+		result.type = this->type;
+		result.record = this->record;
+		result.font = this->font;
+		result.text_runs = this->text_runs;
+		result.text_runs_valid = this->text_runs_valid;
+		result.lines = this->lines;
+		result.color = this->color;
+		result.first_update = false;
+		result.view = this->view;
+		if (this->executable_script) {
+			result.executable_script = make_pooled<::executable_script>(*this->executable_script);
+			result.executable_script->reset_job();
+		}
+		result.invalidate_transform();
+		return result;
 	}
 
 	widget() {
@@ -34,20 +232,34 @@ struct widget {
 	widget(const widget& other) {
 		*this = other;
 	}
+	//moving keeps the script job, swap-and-pop and vector growth rely on it. only a real copy gets its own idle script
+	widget(widget&& other) noexcept = default;
+	widget& operator=(widget&& other) noexcept = default;
 	widget& operator=(const widget& other) {
-		this->text = other.text;
-		this->background = other.background;
+		this->text = other.text ? std::make_unique<qsf::text_field>(*other.text) : nullptr;
 		this->dragging_hitbox = other.dragging_hitbox;
 		this->hitbox = other.hitbox;
+		this->text_hitbox = other.text_hitbox;
 		this->type = other.type;
+		this->id = other.id;
+		this->changes = other.changes;
+		this->record = other.record;
+		this->font = other.font;
+		this->text_runs = other.text_runs;
+		this->lines = other.lines;
+		this->text_runs_valid = other.text_runs_valid;
+		this->archive_index = other.archive_index;
+		this->color = other.color;
 		this->first_update = other.first_update;
 		this->view = other.view;
 		this->hovering = false;
 		this->dragging = false;
 		this->just_selected = false;
+		this->invalidate_transform();
 
 		if (other.executable_script) {
-			this->executable_script = std::make_unique<::executable_script>(*other.executable_script);
+			this->executable_script = make_pooled<::executable_script>(*other.executable_script);
+			this->executable_script->reset_job();
 		}
 		else {
 			this->executable_script.reset();
@@ -56,53 +268,57 @@ struct widget {
 	}
 
 	void save(qpl::save_state& state) const {
-		state.save(this->text.wstring());
+		state.save(this->lines.wstring());
 		state.save(this->view.position);
 		state.save(this->view.scale);
 		state.save(this->type);
 	}
 	bool load(qpl::load_state& state) {
-		this->init();
-
-		std::wstring text_string;
-		state.load(text_string);
-
-		state.load(this->view.position);
-		state.load(this->view.scale);
-
-		state.load(this->type);
-
-		this->set_widget_type(this->type);
-		this->text.set_string(text_string);
+		auto record = std::make_shared<widget_record>();
+		state.load(*record);
+		this->apply(record);
 		return true;
 	}
+	void apply(std::shared_ptr<const widget_record> record) {
+		this->init();
+		this->view.position = record->position;
+		this->view.scale = record->scale;
+		this->invalidate_transform();
+		this->set_widget_type(record->type);
+		this->lines = record->text;
+		this->record = std::move(record);
+	}
+	bool is_materialized() const {
+		return this->archive_index == qpl::size_max;
+	}
 	void init() {
-		this->text.set_font("helvetica");
-		this->text.set_text_character_size(40);
-		this->text.background_increase = { 20, 20 };
-		this->text.background.set_outline_thickness(5.0f);
-		this->text.background.set_outline_color(qpl::rgb::black());
-		this->text.background.set_slope_dimension(config::widget_slope_dimension);
-		this->text.set_position({ 40, 70 });
-
-		this->background.set_color(this->background_color);
-		this->background.set_slope_dimension(config::widget_background_slope_dimension);
+		this->text.reset();
+		this->font = "helvetica";
+		this->color = this->background_color;
 		this->set_position({ 0, 0 });
 		this->first_update = true;
 
 		this->type = widget_type::text;
 		this->executable_script.reset();
+		this->record.reset();
+		this->text_runs.clear();
+		this->text_runs_valid = false;
+		this->lines.assign(L"");
+		++this->text_version;
+		this->invalidate_transform();
 	}
 
 	void set_widget_type(::widget_type type) {
 		this->type = type;
 
 		if (this->type == widget_type::executable_script) {
-			this->executable_script = std::make_unique<::executable_script>();
+			this->executable_script = make_pooled<::executable_script>();
 			this->executable_script->set_background_color(this->background_color);
 
-			this->text.set_font("consola");
+			this->font = "consola";
+			this->text_runs_valid = false;
 		}
+		this->invalidate_transform();
 	}
 
 	void set_position(qpl::vec2 position) {
@@ -111,190 +327,76 @@ struct widget {
 	}
 	void move(qpl::vec2 delta) {
 		this->view.move(delta);
+		this->changes |= widget_changes::moved;
+		this->invalidate_transform();
+	}
+	void set_scale(qpl::vec2 scale) {
+		this->view.scale = scale;
+		this->changes |= widget_changes::moved;
+		this->invalidate_transform();
 	}
 	void update_background() {
-		this->hitbox = this->text.get_background_hitbox().increased(20);
+		if (!this->text_runs_valid) {
+			this->update_lines();
+		}
+		this->hitbox = this->text_hitbox.increased(20);
 		this->hitbox.extend_up(30);
-		this->background.set_hitbox(this->hitbox);
-		this->background.set_color(this->background_color);
+		this->color = this->background_color;
 
 		this->dragging_hitbox = this->hitbox;
 		this->dragging_hitbox.set_height(50);
 		if (this->executable_script) {
 			this->executable_script->update_position(this->hitbox);
 		}
+		++this->text_version;
+		this->invalidate_transform();
 	}
 	void set_background_color(qpl::rgb color) {
-		this->background.set_color(color);
+		if (this->color == color) {
+			return;
+		}
+		this->color = color;
+		this->geometry_changed = true;
 		if (this->executable_script) {
 			this->executable_script->set_background_color(color);
 		}
 	}
 
 	void update_execute_script(const qsf::event_info& event) {
-
 		if (this->executable_script) {
 			event.update(*this->executable_script);
 			if (this->executable_script->clicked) {
-				auto lines = qpl::string_split(this->text.string(), '\n');
-
-				std::unordered_map<std::string, std::string> variables;
-
-				auto get_word_with_variables = [&](std::string word) {
-					std::string result = "";
-					qpl::size begin = qpl::size_max;
-					qpl::size end = 0u;
-					for (qpl::size i = 0u; i < word.length(); ++i) {
-						if (word[i] == '$') {
-							if (begin == qpl::size_max) {
-								result += word.substr(end, i - end);
-								begin = i + 1;
-							}
-							else {
-								auto name = word.substr(begin, i - begin);
-								if (variables.find(name) != variables.cend()) {
-									auto value = variables[name];
-									result += value;
-								}
-								end = i + 1;
-								begin = qpl::size_max;
-							}
-						}
-					}
-					result += word.substr(end, word.length() - end);
-					return result;
-				};
-
-				for (auto& line : lines) {
-					auto words = qpl::string_split(line);
-					if (!words.empty()) {
-						auto command = words[0];
-
-						if (!command.empty()) {
-							if (qpl::string_equals_ignore_case(command, "copy")) {
-								if (words.size() == 3u) {
-
-									auto src = get_word_with_variables(words[1]);
-									auto dest = get_word_with_variables(words[2]);
-
-									qpl::println("copy ", qpl::foreground::aqua, src, "to ", qpl::foreground::aqua, dest);
-									qpl::filesys::copy_overwrite(src, dest);
-								}
-								else {
-									qpl::println("copy: invalid number of arguments.");
-								}
-							}
-							else if (qpl::string_equals_ignore_case(command, "move")) {
-								if (words.size() == 3u) {
-									auto src = get_word_with_variables(words[1]);
-									auto dest = get_word_with_variables(words[2]);
-
-									qpl::println("move ", qpl::foreground::aqua, src, "to ", qpl::foreground::aqua, dest);
-									qpl::filesys::move_overwrite(src, dest);
-								}
-								else {
-									qpl::println("move: invalid number of arguments.");
-								}
-							}
-							else if (qpl::string_equals_ignore_case(command, "remove")) {
-								if (words.size() == 2u) {
-									auto src = get_word_with_variables(words[1]);
-									qpl::println("remove ", qpl::foreground::aqua, src);
-									qpl::filesys::remove(src);
-								}
-								else {
-									qpl::println("remove: invalid number of arguments.");
-								}
-							}
-							else if (qpl::string_equals_ignore_case(command, "rename")) {
-								if (words.size() == 3u) {
-									qpl::println("rename ", qpl::foreground::aqua, words[1], " to ", qpl::foreground::aqua, words[2]);
-									qpl::filesys::rename(words[1], words[2]);
-								}
-								else {
-									qpl::println("rename: invalid number of arguments.");
-								}
-							}
-							else if (qpl::string_equals_ignore_case(command, "sync")) {
-								if (words.size() == 3u) {
-
-									qpl::filesys::path src = get_word_with_variables(words[1]);
-									qpl::filesys::path dest = get_word_with_variables(words[2]);
-
-									if (!src.exists() && !dest.exists()) {
-										qpl::println("sync: both paths don't exist.");
-									}
-									else if (!src.exists()) {
-										src.create();
-										qpl::println("sync ", qpl::foreground::aqua, dest, " to ", qpl::foreground::aqua, src);
-										qpl::filesys::copy_overwrite(dest, src);
-									}
-									else if (!dest.exists()) {
-										dest.create();
-										qpl::println("sync ", qpl::foreground::aqua, src, " to ", qpl::foreground::aqua, dest);
-										qpl::filesys::copy_overwrite(src, dest);
-									}
-									else {
-										auto a_time = src.last_write_time();
-										auto b_time = dest.last_write_time();
-
-										if (a_time < b_time) {
-											qpl::println("sync ", qpl::foreground::aqua, dest, " to ", qpl::foreground::aqua, src);
-											qpl::filesys::copy_overwrite(dest, src);
-										}
-										else if (b_time < a_time) {
-											qpl::println("sync ", qpl::foreground::aqua, src, " to ", qpl::foreground::aqua, dest);
-											qpl::filesys::copy_overwrite(src, dest);
-										}
-										else {
-											qpl::println(qpl::foreground::aqua, src, " and ", qpl::foreground::aqua, dest, " are synchronized already.");
-										}
-									}
-								}
-								else {
-									qpl::println("sync: invalid number of arguments.");
-								}
-							}
-							else if (command[0] == '$' && qpl::count(command, '$') == 1u) {
-								auto name = command.substr(1u);
-								std::string value = "";
-								for (qpl::size i = 1u; i < words.size(); ++i) {
-									bool equals_sign = (words[i] == "=" || words[i] == ":");
-									if (!equals_sign) {
-										value = get_word_with_variables(words[i]);
-										break;
-									}
-								}
-								if (!value.empty()) {
-									variables[name] = value;
-								}
-							}
-							else {
-								qpl::print("ignored command: \"");
-								for (qpl::size i = 0u; i < words.size(); ++i) {
-									if (i) {
-										qpl::print(' ');
-									}
-									qpl::print(get_word_with_variables(words[i]));
-								}
-								qpl::println("\"");
-							}
-						}
-					}
-				}
+				this->executable_script->toggle_job();
 			}
 		}
 	}
 
-	void update(const qsf::event_info& event, bool other_selected) {
-		if (!other_selected) {
-			event.update(this->text);
+	void update(const qsf::event_info& event, bool other_selected, bool hovering) {
+		//clicking the text area starts editing, dragging the title bar doesn't
+		if (!this->text && !other_selected && event.left_mouse_clicked() && this->text_hitbox.contains(event.mouse_position())) {
+			this->begin_editing();
+		}
+		this->just_edited = false;
+		if (this->text && !other_selected) {
+			event.update(*this->text);
+			this->just_edited = this->text->just_changed();
 		}
 
-		if (this->first_update || this->text.just_changed()) {
+		if (this->just_edited) {
+			this->changes |= widget_changes::text;
+		}
+		if (this->first_update || this->just_edited) {
+			this->edited_lines = this->update_lines();
 			this->update_background();
+			if (this->executable_script) {
+				this->executable_script->compile(this->lines);
+			}
 		}
-		this->hovering = this->dragging_hitbox.contains(event.mouse_position());
+		if (this->text && !this->text->has_focus()) {
+			this->end_editing();
+		}
+
+		this->hovering = hovering;
 		this->just_selected = false;
 		if (event.left_mouse_clicked()) {
 			if (this->hovering && !other_selected) {
@@ -318,11 +420,117 @@ struct widget {
 		this->update_execute_script(event);
 		this->first_update = false;
 	}
-	void draw(qsf::draw_object& draw) const {
+	void set_text(const std::wstring& text) {
+		if (this->text) {
+			this->text->set_string(text);
+		}
+		this->lines.assign(text);
+		this->text_runs_valid = false;
+	}
+	//puts back an earlier version of the text (undo/redo), only the differing lines are laid out again.
+	//the rope is kept so the widget shares its lines with the undo history
+	void restore_text(const text_rope& text) {
+		auto change = this->lines.compare(text);
+		this->lines = text;
+		if (this->text) {
+			this->text->set_string(text.wstring());
+		}
+		this->changes |= widget_changes::text;
+		this->layout_lines(change);
+		this->update_background();
+		if (this->executable_script) {
+			this->executable_script->compile(this->lines);
+		}
+	}
+	//takes over the edits of the text field, then lays out the changed lines. returns which lines changed
+	text_rope::line_change update_lines() {
+		text_rope::line_change change;
+		if (this->text) {
+			change = this->lines.update(this->text->wstring());
+		}
+		this->layout_lines(change);
+		return change;
+	}
+	//only the changed line range is re-split and looked up in the run cache
+	void layout_lines(text_rope::line_change change) {
+		profile_scope scope(profile_section::text_layout);
+		if (!this->text_runs_valid) {
+			change.index = 0u;
+			change.inserted = this->lines.size();
+			this->text_runs.clear();
+		}
+		else {
+			auto begin = this->text_runs.begin() + change.index;
+			this->text_runs.erase(begin, begin + change.removed);
+		}
+
+		auto character_size = static_cast<qpl::u32>(config::widget_text_character_size);
+		auto& cache = get_text_run_cache();
+		std::vector<std::shared_ptr<const text_run>> runs(change.inserted);
+		for (qpl::size i = 0u; i < change.inserted; ++i) {
+			runs[i] = cache.get(this->font, character_size, this->lines.line(change.index + i));
+		}
+		this->text_runs.insert(this->text_runs.begin() + change.index, runs.cbegin(), runs.cend());
+		this->text_runs_valid = true;
+
+		qpl::f32 width = 0.f;
+		for (auto& run : this->text_runs) {
+			width = std::max(width, run->width);
+		}
+		auto line_spacing = qsf::get_font(this->font).getLineSpacing(character_size);
+		auto height = line_spacing * std::max<qpl::size>(this->text_runs.size(), 1u);
+		this->text_hitbox.position = text_position - text_background_increase;
+		this->text_hitbox.dimension = qpl::vec(width, height) + text_background_increase * 2.f;
+		++this->text_version;
+	}
+	//only the cached layout can be rendered ahead of time, an edited widget draws its text field with the cursor
+	bool is_text_static() const {
+		return this->text_runs_valid && !this->text;
+	}
+	//local space area the laid out lines are drawn in
+	qpl::hitbox get_text_hitbox() const {
+		return this->text_hitbox.increased(config::widget_texture_margin);
+	}
+	void draw_text(qsf::draw_object& draw) const {
+		this->draw_text_body(draw);
 		if (this->executable_script) {
-			draw.draw(*this->executable_script);
+			this->executable_script->draw_status(draw);
 		}
-		draw.draw(this->background);
-		draw.draw(this->text);
+	}
+	//the text field background is part of the widget batch, only an edited widget draws its text field
+	void draw_text_body(qsf::draw_object& draw) const {
+		if (this->text) {
+			draw.draw(*this->text);
+			get_profiler().count(profile_counter::draw_calls);
+			return;
+		}
+		if (!this->text_runs_valid) {
+			return;
+		}
+		auto character_size = static_cast<qpl::u32>(config::widget_text_character_size);
+		auto& font = qsf::get_font(this->font);
+
+		text_runs_drawable runs;
+		runs.runs = &this->text_runs;
+		runs.texture = &font.getTexture(character_size);
+		runs.position = text_position;
+		runs.line_spacing = font.getLineSpacing(character_size);
+		draw.draw(runs);
+	}
+};
+//widgets::erase moves the last widget into the freed index, a copy there would detach its running job
+static_assert(std::is_nothrow_move_constructible_v<widget> && std::is_nothrow_move_assignable_v<widget>);
+
+//draws only the text parts of a widget, carries the widget view so it's applied like for the widget itself
+struct widget_text_pass {
+	qsf::view view;
+	const widget* source = nullptr;
+
+	widget_text_pass(const widget& widget) {
+		this->view = widget.view;
+		this->source = &widget;
+	}
+	void draw(qsf::draw_object& draw) const {
+		this->source->draw_text(draw);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,354 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include "widget.hpp"
+#include "profiler.hpp"
+#include "config.hpp"
+
+//draws part of a vertex buffer, only vertices that were written and uploaded are ever drawn
+struct vertex_range : sf::Drawable {
+	const sf::VertexBuffer* buffer = nullptr;
+	qpl::size first = 0u;
+	qpl::size count = 0u;
+
+	void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
+		target.draw(*this->buffer, this->first, this->count, states);
+		get_profiler().count(profile_counter::draw_calls);
+	}
+};
+
+//a persistent vertex buffer split into fixed size slots, only dirty slots get re-uploaded.
+//slots are never shrunk away, cleared slots become degenerate triangles so the gpu copy stays in sync
+struct vertex_slots {
+	sf::VertexBuffer buffer{ sf::PrimitiveType::Triangles, sf::VertexBuffer::Dynamic };
+	std::vector<sf::Vertex> vertices;
+	std::vector<qpl::size> dirty_slots;
+	std::vector<bool> dirty;
+	qpl::size slot_size = 0u;
+	qpl::size uploaded_capacity = 0u;
+
+	qpl::size slot_count() const {
+		return this->slot_size ? this->vertices.size() / this->slot_size : 0u;
+	}
+	void clear() {
+		for (qpl::size i = 0u; i < this->slot_count(); ++i) {
+			this->clear_slot(i);
+		}
+	}
+	void reserve(qpl::size slots) {
+		if (slots > this->slot_count()) {
+			this->vertices.resize(slots * this->slot_size);
+			this->dirty.resize(slots, false);
+		}
+	}
+	sf::Vertex* slot(qpl::size index) {
+		this->reserve(index + 1);
+		return this->vertices.data() + index * this->slot_size;
+	}
+	void set_dirty(qpl::size index) {
+		if (!this->dirty[index]) {
+			this->dirty[index] = true;
+			this->dirty_slots.push_back(index);
+		}
+	}
+	void clear_slot(qpl::size index) {
+		auto vertices = this->slot(index);
+		std::fill(vertices, vertices + this->slot_size, sf::Vertex{});
+		this->set_dirty(index);
+	}
+	void copy_slot(qpl::size from, qpl::size to) {
+		this->reserve(std::max(from, to) + 1);
+		auto source = this->slot(from);
+		std::copy(source, source + this->slot_size, this->slot(to));
+		this->set_dirty(to);
+	}
+
+	//count slots from first in one draw call. the gpu buffer may be larger than the vertices written so far, those are never drawn
+	void draw_slots(qsf::draw_object& draw, qpl::size first, qpl::size count) const {
+		auto end = std::min({ (first + count) * this->slot_size, this->vertices.size(), this->uploaded_capacity });
+		if (end <= first * this->slot_size) {
+			return;
+		}
+		vertex_range range;
+		range.buffer = &this->buffer;
+		range.first = first * this->slot_size;
+		range.count = end - range.first;
+		draw.draw(range);
+	}
+	//one draw call per run of consecutive slots, slots have to be ascending
+	void draw_runs(qsf::draw_object& draw, const std::vector<qpl::size>& slots) const {
+		qpl::size begin = 0u;
+		while (begin < slots.size()) {
+			auto end = begin + 1;
+			while (end < slots.size() && slots[end] == slots[end - 1] + 1) {
+				++end;
+			}
+			this->draw_slots(draw, slots[begin], end - begin);
+			begin = end;
+		}
+	}
+
+	void upload() {
+		if (this->vertices.size() > this->uploaded_capacity) {
+			auto capacity = std::max(this->vertices.size(), this->uploaded_capacity * 2);
+			this->buffer.create(capacity);
+			this->uploaded_capacity = capacity;
+			this->buffer.update(this->vertices.data(), this->vertices.size(), 0u);
+			for (auto& i : this->dirty_slots) {
+				this->dirty[i] = false;
+			}
+			this->dirty_slots.clear();
+			return;
+		}
+		if (this->dirty_slots.empty()) {
+			return;
+		}
+
+		qpl::sort(this->dirty_slots, [](auto a, auto b) {
+			return a < b;
+			});
+
+		qpl::size begin = 0u;
+		while (begin < this->dirty_slots.size()) {
+			auto end = begin + 1;
+			while (end < this->dirty_slots.size() && this->dirty_slots[end] == this->dirty_slots[end - 1] + 1) {
+				++end;
+			}
+			auto offset = this->dirty_slots[begin] * this->slot_size;
+			auto count = (end - begin) * this->slot_size;
+			this->buffer.update(this->vertices.data() + offset, count, static_cast<unsigned>(offset));
+			begin = end;
+		}
+		for (auto& i : this->dirty_slots) {
+			this->dirty[i] = false;
+		}
+		this->dirty_slots.clear();
+	}
+};
+
+//packs all widget and text field backgrounds into one persistent vertex buffer and the executable script
+//chrome into a second one. background slots are laid out by draw order position, so widgets that are next to
+//each other in draw order are drawn with one call. script chrome slots are handed out from a free list
+//and drawn in runs of consecutive slots as well
+struct widget_batch {
+	constexpr static qpl::size corner_segments = config::widget_batch_corner_segments;
+	constexpr static qpl::size rounded_rectangle_size = 3u * 4u * (corner_segments + 1);
+	//widget background, then the outline and fill of the text field background
+	constexpr static qpl::size background_slot_size = 3u * rounded_rectangle_size;
+	constexpr static qpl::size script_slot_size = 3u * rounded_rectangle_size + 3u + 6u + 3u * corner_segments;
+
+	vertex_slots backgrounds;
+	vertex_slots scripts;
+	//script chrome slot of each draw order position
+	std::vector<qpl::size> script_slot;
+	std::vector<qpl::size> free_script_slots;
+	qpl::size size = 0u;
+	mutable std::vector<qpl::size> script_runs;
+
+	widget_batch() {
+		this->backgrounds.slot_size = background_slot_size;
+		this->scripts.slot_size = script_slot_size;
+	}
+
+	void clear() {
+		this->backgrounds.clear();
+		this->scripts.clear();
+		this->script_slot.clear();
+		this->free_script_slots.clear();
+		this->size = 0u;
+		for (qpl::size i = 0u; i < this->scripts.slot_count(); ++i) {
+			this->free_script_slots.push_back(i);
+		}
+	}
+
+	//index is the widget's draw order position
+	void set(qpl::size index, const widget& widget) {
+		if (index >= this->script_slot.size()) {
+			this->script_slot.resize(index + 1, qpl::size_max);
+		}
+		this->size = std::max(this->size, index + 1);
+		auto transform = [&](qpl::vec2 position) {
+			return widget.transform_point(position);
+		};
+
+		auto out = this->backgrounds.slot(index);
+		out = write_rounded_rectangle(out, widget.hitbox, config::widget_background_slope_dimension, { true, true, true, true }, widget.color, transform);
+		out = write_rounded_rectangle(out, widget.text_hitbox.increased(5), config::widget_slope_dimension + 5, { true, true, true, true }, qpl::rgb::black(), transform);
+		write_rounded_rectangle(out, widget.text_hitbox, config::widget_slope_dimension, { true, true, true, true }, config::widget_text_background_color, transform);
+		this->backgrounds.set_dirty(index);
+
+		if (!widget.executable_script) {
+			this->release_script_slot(index);
+			return;
+		}
+		if (this->script_slot[index] == qpl::size_max) {
+			if (this->free_script_slots.empty()) {
+				this->script_slot[index] = this->scripts.slot_count();
+			}
+			else {
+				this->script_slot[index] = this->free_script_slots.back();
+				this->free_script_slots.pop_back();
+			}
+		}
+		auto slot = this->script_slot[index];
+		write_script(this->scripts.slot(slot), *widget.executable_script, transform);
+		this->scripts.set_dirty(slot);
+	}
+	void remove(qpl::size index) {
+		if (index < this->backgrounds.slot_count()) {
+			this->backgrounds.clear_slot(index);
+		}
+		this->release_script_slot(index);
+	}
+	//the widget at draw order position from moved to position to
+	void move_index(qpl::size from, qpl::size to) {
+		if (from == to) {
+			return;
+		}
+		this->remove(to);
+		this->backgrounds.copy_slot(from, to);
+		this->backgrounds.clear_slot(from);
+		//placeholders that were never set have no entry yet
+		if (std::max(from, to) >= this->script_slot.size()) {
+			this->script_slot.resize(std::max(from, to) + 1, qpl::size_max);
+		}
+		this->script_slot[to] = this->script_slot[from];
+		this->script_slot[from] = qpl::size_max;
+		this->size = std::max(this->size, to + 1);
+	}
+	void resize(qpl::size size) {
+		for (qpl::size i = size; i < this->size; ++i) {
+			this->remove(i);
+		}
+		this->size = size;
+		this->script_slot.resize(size, qpl::size_max);
+	}
+
+	void upload() {
+		this->backgrounds.upload();
+		this->scripts.upload();
+	}
+	//draws the given draw order positions, which have to be ascending. the caller makes sure none of them overlap,
+	//so all script chrome can go first: it sits behind its own widget's background
+	void draw(qsf::draw_object& draw, const std::vector<qpl::size>& positions) const {
+		this->script_runs.clear();
+		for (auto& position : positions) {
+			if (position < this->script_slot.size() && this->script_slot[position] != qpl::size_max) {
+				this->script_runs.push_back(this->script_slot[position]);
+			}
+		}
+		std::ranges::sort(this->script_runs);
+		this->scripts.draw_runs(draw, this->script_runs);
+		this->backgrounds.draw_runs(draw, positions);
+	}
+
+private:
+	void release_script_slot(qpl::size index) {
+		if (index < this->script_slot.size() && this->script_slot[index] != qpl::size_max) {
+			this->scripts.clear_slot(this->script_slot[index]);
+			this->free_script_slots.push_back(this->script_slot[index]);
+			this->script_slot[index] = qpl::size_max;
+		}
+	}
+
+	template<typename F>
+	static sf::Vertex* write_rounded_rectangle(sf::Vertex* out, qpl::hitbox hitbox, qpl::f32 radius, std::array<bool, 4u> round, qpl::rgb color, F&& transform) {
+		radius = std::min({ radius, hitbox.dimension.x / 2, hitbox.dimension.y / 2 });
+
+		auto x1 = hitbox.position.x;
+		auto y1 = hitbox.position.y;
+		auto x2 = hitbox.position.x + hitbox.dimension.x;
+		auto y2 = hitbox.position.y + hitbox.dimension.y;
+
+		//top left, top right, bottom right, bottom left - clockwise
+		std::array<qpl::vec2, 4u> corners = { qpl::vec(x1, y1), qpl::vec(x2, y1), qpl::vec(x2, y2), qpl::vec(x1, y2) };
+		std::array<qpl::vec2, 4u> centers = {
+			qpl::vec(x1 + radius, y1 + radius),
+			qpl::vec(x2 - radius, y1 + radius),
+			qpl::vec(x2 - radius, y2 - radius),
+			qpl::vec(x1 + radius, y2 - radius)
+		};
+
+		std::array<qpl::vec2, 4u * (corner_segments + 1)> perimeter;
+		for (qpl::size c = 0u; c < 4u; ++c) {
+			auto start = qpl::pi * (1.0 + 0.5 * c);
+			for (qpl::size s = 0u; s <= corner_segments; ++s) {
+				auto& point = perimeter[c * (corner_segments + 1) + s];
+				if (round[c]) {
+					auto angle = start + (qpl::pi / 2) * s / corner_segments;
+					point = centers[c] + qpl::vec(static_cast<qpl::f32>(std::cos(angle)), static_cast<qpl::f32>(std::sin(angle))) * radius;
+				}
+				else {
+					point = corners[c];
+				}
+			}
+		}
+
+		auto center = transform(hitbox.get_center());
+		for (qpl::size i = 0u; i < perimeter.size(); ++i) {
+			auto next = (i + 1) % perimeter.size();
+			out[0].position = center;
+			out[1].position = transform(perimeter[i]);
+			out[2].position = transform(perimeter[next]);
+			for (qpl::size v = 0u; v < 3u; ++v) {
+				out[v].color = color;
+			}
+			out += 3;
+		}
+		return out;
+	}
+
+	template<typename F>
+	static void write_script(sf::Vertex* out, const executable_script& script, F&& transform) {
+		auto hitbox = script.get_hitbox();
+		auto background = hitbox.extended_up(60);
+		out = write_rounded_rectangle(out, background, config::widget_background_slope_dimension, { false, false, true, true }, script.current_background_color, transform);
+
+		qpl::hitbox box;
+		box.set_dimension({ 90, 90 });
+		box.set_center(hitbox.get_center());
+		out = write_rounded_rectangle(out, box.increased(5), config::widget_slope_dimension + 5, { true, true, true, true }, qpl::rgb::black(), transform);
+		out = write_rounded_rectangle(out, box, config::widget_slope_dimension, { true, true, true, true }, script.current_checkmark_box_color, transform);
+
+		auto checkmark = script.get_checkmark();
+		for (qpl::size i = 0u; i < 3u; ++i) {
+			out[i].position = transform(checkmark[i]);
+			out[i].color = script.current_checkmark_color;
+		}
+		out += 3;
+
+		auto progress = script.get_progress_hitbox();
+		if (script.displayed_state != script_state::running) {
+			progress.dimension = qpl::vec(0, 0);
+		}
+		std::array<qpl::vec2, 4u> corners = {
+			progress.position,
+			progress.position + qpl::vec(progress.dimension.x, 0),
+			progress.position + progress.dimension,
+			progress.position + qpl::vec(0, progress.dimension.y)
+		};
+		constexpr std::array<qpl::size, 6u> triangles = { 0, 1, 2, 0, 2, 3 };
+		for (qpl::size i = 0u; i < triangles.size(); ++i) {
+			out[i].position = transform(corners[triangles[i]]);
+			out[i].color = script.progress_bar_color;
+		}
+		out += 6;
+
+		//inverted corner that joins the script background with the widget background
+		constexpr qpl::f32 corner_size = 40.f;
+		auto apex = hitbox.get_top_left() + qpl::vec(0, 15);
+		auto circle = apex + qpl::vec(-corner_size, corner_size);
+		auto arc = [&](qpl::size s) {
+			auto angle = (qpl::pi / 2) * s / corner_segments;
+			return circle + qpl::vec(static_cast<qpl::f32>(std::sin(angle)), -static_cast<qpl::f32>(std::cos(angle))) * corner_size;
+		};
+		for (qpl::size s = 0u; s < corner_segments; ++s) {
+			out[0].position = transform(apex);
+			out[1].position = transform(arc(s));
+			out[2].position = transform(arc(s + 1));
+			for (qpl::size v = 0u; v < 3u; ++v) {
+				out[v].color = script.current_background_color;
+			}
+			out += 3;
+		}
+	}
+};
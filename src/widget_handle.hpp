@@ -0,0 +1,80 @@
+#pragma once
+#include <qpl/qpl.hpp>
+
+//stable reference to a widget, stays valid while other widgets are added or removed.
+//a removed widget bumps its slot generation so old handles to it resolve to nothing
+struct widget_handle {
+	constexpr static qpl::u32 invalid_slot = std::numeric_limits<qpl::u32>::max();
+
+	qpl::u32 slot = invalid_slot;
+	qpl::u32 generation = 0u;
+
+	bool operator==(const widget_handle& other) const = default;
+};
+
+//maps handles to the current dense index of a widget and back
+struct widget_handle_map {
+	std::vector<qpl::u32> generations;
+	std::vector<qpl::size> slot_indices;
+	std::vector<qpl::u32> index_slots;
+	std::vector<qpl::u32> free_slots;
+
+	void clear() {
+		this->generations.clear();
+		this->slot_indices.clear();
+		this->index_slots.clear();
+		this->free_slots.clear();
+	}
+	void assign(qpl::size size) {
+		this->clear();
+		for (qpl::size i = 0u; i < size; ++i) {
+			this->create(i);
+		}
+	}
+	widget_handle create(qpl::size index) {
+		qpl::u32 slot;
+		if (this->free_slots.empty()) {
+			slot = static_cast<qpl::u32>(this->generations.size());
+			this->generations.push_back(0u);
+			this->slot_indices.push_back(index);
+		}
+		else {
+			slot = this->free_slots.back();
+			this->free_slots.pop_back();
+			this->slot_indices[slot] = index;
+		}
+		if (index >= this->index_slots.size()) {
+			this->index_slots.resize(index + 1, widget_handle::invalid_slot);
+		}
+		this->index_slots[index] = slot;
+		return { slot, this->generations[slot] };
+	}
+	void erase(qpl::size index) {
+		auto slot = this->index_slots[index];
+		++this->generations[slot];
+		this->slot_indices[slot] = qpl::size_max;
+		this->index_slots[index] = widget_handle::invalid_slot;
+		this->free_slots.push_back(slot);
+	}
+	//the widget at index from now lives at index to, e.g. after a swap-and-pop
+	void move_index(qpl::size from, qpl::size to) {
+		auto slot = this->index_slots[from];
+		this->slot_indices[slot] = to;
+		this->index_slots[to] = slot;
+		this->index_slots[from] = widget_handle::invalid_slot;
+	}
+	void resize(qpl::size size) {
+		this->index_slots.resize(size, widget_handle::invalid_slot);
+	}
+
+	qpl::size get(widget_handle handle) const {
+		if (handle.slot >= this->generations.size() || this->generations[handle.slot] != handle.generation) {
+			return qpl::size_max;
+		}
+		return this->slot_indices[handle.slot];
+	}
+	widget_handle get_handle(qpl::size index) const {
+		auto slot = this->index_slots[index];
+		return { slot, this->generations[slot] };
+	}
+};
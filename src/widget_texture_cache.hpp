@@ -0,0 +1,180 @@
+#pragma once
+#include <qpl/qpl.hpp>
+#include <cmath>
+#include <list>
+#include "widget.hpp"
+#include "widget_handle.hpp"
+#include "profiler.hpp"
+#include "config.hpp"
+
+//the render texture starts out transparent, so the alpha blended text leaves its colors multiplied by alpha.
+//blending it with the plain alpha blend would multiply them again and darken the glyph edges
+struct premultiplied_sprite : sf::Drawable {
+	sf::Sprite sprite;
+
+	void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
+		states.blendMode = sf::BlendMode(sf::BlendMode::One, sf::BlendMode::OneMinusSrcAlpha);
+		target.draw(this->sprite, states);
+		get_profiler().count(profile_counter::draw_calls);
+	}
+};
+
+//the text pass of one widget rasterized at one zoom level
+struct widget_texture {
+	std::unique_ptr<sf::RenderTexture> texture;
+	widget_handle handle;
+	qpl::u64 text_version = 0u;
+	qpl::i32 zoom_level = 0;
+	//local space area the texture covers
+	qpl::hitbox hitbox;
+	qpl::size bytes = 0u;
+	qpl::u64 last_frame = 0u;
+	std::list<qpl::u32>::iterator lru;
+	bool valid = false;
+
+	void draw(qsf::draw_object& draw) const {
+		premultiplied_sprite sprite;
+		sprite.sprite.setTexture(this->texture->getTexture());
+		sprite.sprite.setPosition(this->hitbox.position);
+		auto scale = this->hitbox.dimension.x / static_cast<qpl::f32>(this->texture->getSize().x);
+		sprite.sprite.setScale(scale, scale);
+		draw.draw(sprite);
+	}
+};
+
+//keeps the laid out lines of static widgets as one texture each, keyed by handle slot. a widget is
+//rasterized once per zoom level and then drawn as a single quad until its text_version changes; panning never re-renders. zoom levels are config::widget_texture_zoom_steps per
+//octave so zooming only re-renders when the scale changed noticeably. textures are evicted least recently
+//drawn first once config::widget_texture_memory_limit is exceeded, textures drawn this frame are never
+//evicted. at most config::widget_texture_renders_per_frame widgets are rasterized per frame,
+//the rest is drawn directly until it gets its turn
+struct widget_texture_cache {
+	std::vector<widget_texture> textures;
+	//front is the least recently drawn
+	std::list<qpl::u32> lru;
+	qpl::size bytes = 0u;
+	qpl::u64 frame = 1u;
+	qpl::size renders = 0u;
+
+	void clear() {
+		this->textures.clear();
+		this->lru.clear();
+		this->bytes = 0u;
+	}
+	void remove(qpl::u32 slot) {
+		if (slot >= this->textures.size() || !this->textures[slot].valid) {
+			return;
+		}
+		auto& texture = this->textures[slot];
+		this->bytes -= texture.bytes;
+		this->lru.erase(texture.lru);
+		texture = {};
+	}
+	void next_frame() {
+		++this->frame;
+		this->renders = 0u;
+	}
+
+	static qpl::i32 get_zoom_level(qpl::f32 pixels_per_unit) {
+		return static_cast<qpl::i32>(std::round(std::log2(pixels_per_unit) * config::widget_texture_zoom_steps));
+	}
+	static qpl::f32 get_zoom_scale(qpl::i32 level) {
+		return std::exp2(static_cast<qpl::f32>(level) / config::widget_texture_zoom_steps);
+	}
+
+	//the cached texture of the widget, rendered or re-rendered if needed. nullptr means it has to be drawn directly
+	const widget_texture* get(widget_handle handle, const widget& widget, qpl::f32 world_units_per_pixel) {
+		if (!widget.is_text_static()) {
+			return nullptr;
+		}
+		auto level = get_zoom_level(widget.get_world_scale() / world_units_per_pixel);
+		if (handle.slot >= this->textures.size()) {
+			this->textures.resize(handle.slot + 1);
+		}
+		auto& texture = this->textures[handle.slot];
+		bool current = texture.valid && texture.handle == handle && texture.text_version == widget.text_version && texture.zoom_level == level;
+		if (!current && !this->render(handle, widget, level)) {
+			return nullptr;
+		}
+		texture.last_frame = this->frame;
+		this->lru.splice(this->lru.end(), this->lru, texture.lru);
+		return &texture;
+	}
+
+private:
+	bool render(widget_handle handle, const widget& widget, qpl::i32 level) {
+		if (this->renders >= config::widget_texture_renders_per_frame) {
+			return false;
+		}
+		auto scale = get_zoom_scale(level);
+		auto hitbox = widget.get_text_hitbox();
+		auto width = static_cast<qpl::u32>(std::ceil(hitbox.dimension.x * scale));
+		auto height = static_cast<qpl::u32>(std::ceil(hitbox.dimension.y * scale));
+		if (!width || !height || width > config::widget_texture_max_size || height > config::widget_texture_max_size) {
+			this->remove(handle.slot);
+			return false;
+		}
+		qpl::size bytes = qpl::size{ width } * height * 4u;
+		this->remove(handle.slot);
+		if (!this->evict(bytes)) {
+			return false;
+		}
+
+		auto& texture = this->textures[handle.slot];
+		texture.texture = std::make_unique<sf::RenderTexture>();
+		if (!texture.texture->create(width, height)) {
+			texture = {};
+			return false;
+		}
+		//the hitbox is widened to whole pixels so the quad maps texels 1:1 at this zoom level
+		hitbox.dimension = qpl::vec(static_cast<qpl::f32>(width), static_cast<qpl::f32>(height)) / scale;
+		sf::RenderStates states;
+		states.transform.scale(scale, scale);
+		states.transform.translate(-hitbox.position.x, -hitbox.position.y);
+		texture.texture->clear(sf::Color::Transparent);
+		qsf::draw_object target(*texture.texture, states);
+		widget.draw_text_body(target);
+		texture.texture->display();
+
+		texture.handle = handle;
+		texture.text_version = widget.text_version;
+		texture.zoom_level = level;
+		texture.hitbox = hitbox;
+		texture.bytes = bytes;
+		texture.valid = true;
+		texture.lru = this->lru.insert(this->lru.end(), handle.slot);
+		this->bytes += bytes;
+		++this->renders;
+		get_profiler().count(profile_counter::texture_renders);
+		return true;
+	}
+	//makes room for bytes more, fails if only textures drawn this frame are left
+	bool evict(qpl::size bytes) {
+		while (this->bytes + bytes > config::widget_texture_memory_limit) {
+			if (this->lru.empty() || this->textures[this->lru.front()].last_frame == this->frame) {
+				return false;
+			}
+			this->remove(this->lru.front());
+		}
+		return true;
+	}
+};
+
+//draws a widget's cached text pass with the widget view, the script status changes while it runs and stays live
+struct cached_text_pass {
+	qsf::view view;
+	const widget* source = nullptr;
+	const widget_texture* texture = nullptr;
+
+	cached_text_pass(const widget& widget, const widget_texture& texture) {
+		this->view = widget.view;
+		this->source = &widget;
+		this->texture = &texture;
+	}
+	void draw(qsf::draw_object& draw) const {
+		this->texture->draw(draw);
+		if (this->source->executable_script) {
+			this->source->executable_script->draw_status(draw);
+		}
+	}
+};
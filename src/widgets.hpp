@@ -1,40 +1,213 @@
 #pragma once
 #include <qpl/qpl.hpp>
 #include "widget.hpp"
+#include "spatial_grid.hpp"
+#include "widget_batch.hpp"
+#include "session_archive.hpp"
+#include "z_order.hpp"
+#include "widget_handle.hpp"
 #include "crypto.hpp"
+#include "profiler.hpp"
+#include "script_pipeline.hpp"
+#include "search_index.hpp"
+#include "undo_log.hpp"
+#include "widget_texture_cache.hpp"
 
 struct widgets {
 	qsf::view view;
+	//widget payloads (text, layout, script), hot per-frame data lives in the dense arrays below
 	std::vector<widget> widgets;
-	std::list<qpl::size> draw_order;
+	widget_handle_map handles;
+	//world space drag areas by index, the hover test only touches these
+	std::vector<qpl::hitbox> drag_hitboxes;
+	z_order draw_order;
+	spatial_grid grid;
+	widget_batch batch;
+
+	qpl::hitbox visible_hitbox;
+	qpl::f32 world_units_per_pixel = 1.f;
+	bool culling = false;
+	mutable qsf::vertex_array lod_rectangles;
+	mutable std::vector<qpl::u32> visible_marks;
+	mutable qpl::u32 visible_mark = 0u;
+	//widgets drawn together in one group of the text pass, see draw
+	mutable std::vector<qpl::u32> group_marks;
+	mutable qpl::u32 group_mark = 0u;
+	mutable std::vector<qpl::size> group_widgets;
+	mutable std::vector<qpl::size> group_positions;
+	//rasterized text of static widgets, drawn as one quad each
+	mutable widget_texture_cache texture_cache;
+
+	//widgets are only updated when they are hovered, focused, dragged, animating or new
+	std::vector<widget_handle> pending_updates;
+
+	widget_handle selected;
+	widget_handle focused;
+	widget_handle dragging;
+	widget_handle copied;
+
+	qpl::u64 next_id = 1u;
+	std::vector<qpl::u64> deleted_ids;
+
+	//widgets waiting to be indexed after a load or paste, a few are indexed per frame
+	search_index search;
+	std::vector<widget_handle> pending_search;
+
+	//moves, text edits, pastes and deletions for ctrl+z / ctrl+y
+	undo_log history;
+	//where the dragged widget was when the drag started, the whole drag becomes one move
+	qpl::vec2 drag_origin;
+
+	//kept alive until every script in them has finished
+	std::vector<std::shared_ptr<script_pipeline>> pipelines;
+
+	//widgets loaded from an archive are placeholders until they come into view or their record was decoded
+	//in the background. a placeholder holds no text, layout or script, only its archive index
+	session_archive archive;
+	archive_decoder decoder;
+	//widget index of every archived widget that is still a placeholder, size_max once it's materialized or gone
+	std::vector<qpl::size> archive_widgets;
+	qpl::size unmaterialized_count = 0u;
 
-	qpl::size selected_index = qpl::size_max;
-	qpl::size copy_index = qpl::size_max;
 	bool allow_view_drag = true;
 	bool any_text_field_focus = false;
+	//set while a text field outside the board (e.g. the search bar) takes the keyboard
+	bool keyboard_captured = false;
 	bool turbo = false;
 
 	void save(qpl::save_state& state) const {
 		state.save(this->widgets);
-	
-		std::vector<qpl::size> order(this->widgets.size());
-		auto it = this->draw_order.begin();
-		for (qpl::size i = 0u; i < this->widgets.size(); ++i) {
-			order[i] = *it;
-			++it;
-		}
-		state.save(order);
+		state.save(this->draw_order.to_vector());
 	}
 	void load(qpl::load_state& state) {
 		state.load(this->widgets);
 
 		std::vector<qpl::size> order;
 		state.load(order);
-		this->draw_order.clear();
-		for (auto& i : order) {
-			this->draw_order.push_back(i);
+		this->draw_order.assign(order, this->widgets.size());
+		this->reset_handles();
+		this->renumber_ids();
+		this->close_archive();
+		this->loaded();
+	}
+	//creates placeholders for every archived widget, nothing is decoded yet
+	void load_archive(session_archive&& archive) {
+		this->close_archive();
+		this->archive = std::move(archive);
+		this->widgets.clear();
+		this->widgets.resize(this->archive.size());
+		this->archive_widgets.resize(this->archive.size());
+		for (qpl::size i = 0u; i < this->widgets.size(); ++i) {
+			this->widgets[i].archive_index = i;
+			this->archive_widgets[i] = i;
+		}
+		this->draw_order.assign(this->archive.order, this->widgets.size());
+		this->reset_handles();
+		this->unmaterialized_count = this->widgets.size();
+		this->renumber_ids();
+		this->decoder.start(this->archive);
+	}
+	void close_archive() {
+		this->decoder.stop();
+		this->archive.clear();
+		this->archive_widgets.clear();
+		this->unmaterialized_count = 0u;
+	}
+	//every widget gets a fresh handle, old handles are meaningless after a reload
+	void reset_handles() {
+		this->history.clear();
+		this->texture_cache.clear();
+		this->handles.assign(this->widgets.size());
+		this->drag_hitboxes.assign(this->widgets.size(), qpl::hitbox{});
+	}
+	qpl::size index_of(widget_handle handle) const {
+		return this->handles.get(handle);
+	}
+	void queue_update(qpl::size index) {
+		this->pending_updates.push_back(this->handles.get_handle(index));
+	}
+	//a record the journal replaced or the decoder already delivered is used as is, otherwise it's decoded right here
+	void materialize(qpl::size index, std::shared_ptr<const widget_record> decoded = nullptr) {
+		auto& widget = this->widgets[index];
+		if (widget.is_materialized()) {
+			return;
+		}
+		auto changes = widget.changes;
+		auto record = widget.record ? widget.record : decoded ? std::move(decoded) : this->archive.decode(widget.archive_index);
+		widget.apply(std::move(record));
+		this->archive_widgets[widget.archive_index] = qpl::size_max;
+		widget.archive_index = qpl::size_max;
+		widget.changes = changes;
+		widget.update_background();
+		--this->unmaterialized_count;
+
+		this->update_caches(index);
+		this->queue_update(index);
+		if (this->unmaterialized_count == 0u) {
+			this->close_archive();
 		}
 	}
+	//materializes everything near the view, then applies a few records per frame that the decoder finished
+	void stream_widgets() {
+		if (this->unmaterialized_count == 0u) {
+			return;
+		}
+		if (this->culling) {
+			std::vector<qpl::size> visible;
+			this->grid.for_each_in(this->visible_hitbox.increased(config::widget_cull_margin), [&](qpl::size index) {
+				if (index < this->widgets.size() && !this->widgets[index].is_materialized()) {
+					visible.push_back(index);
+				}
+			});
+			for (auto& i : visible) {
+				this->materialize(i);
+			}
+		}
+		archive_decoder::decoded decoded;
+		for (qpl::size budget = config::widget_stream_per_frame; budget && this->unmaterialized_count && this->decoder.take(decoded); ) {
+			auto index = this->archive_widgets[decoded.index];
+			if (index != qpl::size_max) {
+				this->materialize(index, std::move(decoded.record));
+				--budget;
+			}
+		}
+		this->batch.upload();
+	}
+	qpl::hitbox get_bounds(qpl::size index) const {
+		auto& widget = this->widgets[index];
+		if (!widget.is_materialized()) {
+			return this->archive.get_bounds(widget.archive_index);
+		}
+		return widget.get_bounds();
+	}
+	std::shared_ptr<const widget_record> get_record(qpl::size index) {
+		auto& widget = this->widgets[index];
+		if (!widget.is_materialized()) {
+			if (!widget.record) {
+				widget.record = this->archive.decode(widget.archive_index);
+			}
+			return widget.record;
+		}
+		return widget.get_record();
+	}
+
+	//resets all derived state after widgets and draw_order were replaced wholesale
+	void loaded() {
+		this->selected = {};
+		this->focused = {};
+		this->dragging = {};
+		this->copied = {};
+		this->pending_updates.clear();
+		this->deleted_ids.clear();
+		this->search.clear();
+		this->pending_search.clear();
+		for (qpl::size i = 0u; i < this->widgets.size(); ++i) {
+			this->queue_update(i);
+			this->pending_search.push_back(this->handles.get_handle(i));
+			this->widgets[i].changes = 0u;
+		}
+		this->rebuild_caches();
+	}
 
 	widget get_default_widget() const {
 		widget widget;
@@ -54,45 +227,129 @@ struct widgets {
 		return widget;
 	}
 
-	void add(widget&& widget) {
+	void renumber_ids() {
+		for (qpl::size i = 0u; i < this->widgets.size(); ++i) {
+			this->widgets[i].id = i + 1;
+			this->widgets[i].changes = 0u;
+		}
+		this->next_id = this->widgets.size() + 1;
+	}
+	//appends a widget on top, the caches are left to the caller
+	qpl::size insert(widget&& widget) {
 		this->widgets.emplace_back(std::move(widget));
-		this->draw_order.push_back(this->widgets.size() - 1);
+		auto index = this->widgets.size() - 1;
+		this->draw_order.push_back(index);
+		this->pending_search.push_back(this->handles.create(index));
+		this->drag_hitboxes.emplace_back();
+		return index;
+	}
+	//swap-and-pop, the last widget takes over the removed index. the caches are left to the caller
+	void erase(qpl::size index) {
+		auto last = this->widgets.size() - 1;
+		if (!this->widgets[index].is_materialized()) {
+			this->archive_widgets[this->widgets[index].archive_index] = qpl::size_max;
+			--this->unmaterialized_count;
+		}
+		if (index != last && !this->widgets[last].is_materialized()) {
+			this->archive_widgets[this->widgets[last].archive_index] = index;
+		}
+		this->draw_order.remove(index);
+		this->search.remove(this->handles.get_handle(index).slot);
+		this->texture_cache.remove(this->handles.get_handle(index).slot);
+		this->handles.erase(index);
+		if (index != last) {
+			this->widgets[index] = std::move(this->widgets.back());
+			this->drag_hitboxes[index] = this->drag_hitboxes.back();
+			this->draw_order.move_index(last, index);
+			this->handles.move_index(last, index);
+		}
+		this->widgets.pop_back();
+		this->drag_hitboxes.pop_back();
+		this->draw_order.resize(this->widgets.size());
+		this->handles.resize(this->widgets.size());
+		this->compact_draw_order();
+	}
+	//the batch is laid out by draw order position, its slots follow the widgets when tombstones are compacted away
+	void compact_draw_order() {
+		this->draw_order.compact_if_sparse([&](qpl::size from, qpl::size to) {
+			this->batch.move_index(from, to);
+		});
+		this->batch.resize(this->draw_order.slots.size());
+	}
+	void add(widget&& widget) {
+		widget.id = this->next_id++;
+		widget.changes = widget_changes::created;
+		auto index = this->insert(std::move(widget));
+		this->queue_update(index);
+		this->update_caches(index);
 	}
 
 	void load_default() {
-		this->widgets.resize(1u);
-		this->widgets[0u] = this->get_default_widget();
-		this->draw_order.push_back(0u);
+		this->widgets.clear();
+		this->draw_order.clear();
+		this->handles.clear();
+		this->drag_hitboxes.clear();
+		this->pending_updates.clear();
+		this->selected = {};
+		this->focused = {};
+		this->dragging = {};
+		this->copied = {};
+		this->deleted_ids.clear();
+		this->search.clear();
+		this->pending_search.clear();
+		this->history.clear();
+		this->texture_cache.clear();
+		this->next_id = 1u;
+		this->close_archive();
+		this->grid.clear();
+		this->batch.clear();
+		this->add(this->get_default_widget());
 	}
 
-	bool hitbox_collides_with_widget(qpl::hitbox hitbox) const {
-		for (auto& i : this->widgets) {
-			if (hitbox.collides(i.get_hitbox())) {
-				return true;
+	void update_caches(qpl::size index) {
+		auto& widget = this->widgets[index];
+		if (!widget.is_materialized()) {
+			if (widget.hitbox_changed) {
+				this->grid.set(index, this->get_bounds(index));
+				widget.hitbox_changed = false;
 			}
+			return;
+		}
+		if (widget.hitbox_changed) {
+			this->grid.set(index, widget.get_bounds());
+			this->drag_hitboxes[index] = widget.get_dragging_hitbox();
+			widget.hitbox_changed = false;
+		}
+		if (widget.take_geometry_changed()) {
+			this->batch.set(this->draw_order.depth(index), widget);
 		}
-		return false;
 	}
-
-	qpl::hitbox find_free_spot_for(qpl::hitbox hitbox) const {
-
-		std::vector<std::pair<qpl::size, qpl::f64>> distances(this->widgets.size());
+	void rebuild_caches() {
+		this->grid.clear();
+		this->batch.clear();
 		for (qpl::size i = 0u; i < this->widgets.size(); ++i) {
-			distances[i].first = i;
-			distances[i].second = (hitbox.get_center() - this->widgets[i].get_hitbox().get_center()).length();
+			this->widgets[i].hitbox_changed = true;
+			this->widgets[i].geometry_changed = true;
+			this->update_caches(i);
 		}
-		qpl::sort(distances, [](auto a, auto b) {
-			return a.second < b.second;
-			});
+	}
 
+	bool hitbox_collides_with_widget(qpl::hitbox hitbox) const {
+		return this->grid.collides(hitbox);
+	}
+
+	qpl::hitbox find_free_spot_for(qpl::hitbox hitbox) const {
+		if (this->grid.empty()) {
+			return hitbox;
+		}
 
 		std::array<qpl::size, 4u> sides;
 		for (qpl::size i = 0u; i < sides.size(); ++i) {
 			sides[i] = i;
 		}
 
-		for (auto& widget : distances) {
-			auto widget_hitbox = this->widgets[widget.first].get_hitbox();
+		bool found = this->grid.for_each_nearest(hitbox.get_center(), [&](qpl::size index) {
+			auto widget_hitbox = this->grid.hitboxes[index];
 			qpl::shuffle(sides);
 
 			for (const auto& i : sides) {
@@ -101,111 +358,374 @@ struct widgets {
 
 				hitbox.set_side_corner_left(i, pos);
 				if (!this->hitbox_collides_with_widget(hitbox)) {
-					return hitbox;
+					return true;
 				}
 			}
+			return false;
+		});
+		if (found) {
+			return hitbox;
 		}
 		throw qpl::exception("widgets::find_free_spot_for(", hitbox.string(), ") : no spot found. this shouldn't be possible!");
 		return {};
 	}
 
 	void paste(qpl::vec2f position) {
-		if (this->copy_index != qpl::size_max) {
-			auto hitbox = this->widgets[this->copy_index].get_hitbox();
+		auto source = this->index_of(this->copied);
+		if (source != qpl::size_max) {
+			auto hitbox = this->widgets[source].get_hitbox();
 			hitbox.set_center(position);
 
 			if (this->hitbox_collides_with_widget(hitbox)) {
 				hitbox = this->find_free_spot_for(hitbox);
 			}
 
-			this->widgets.push_back(this->widgets[this->copy_index]);
-			this->widgets.back().set_position(hitbox.position);
-			this->widgets.back().update_background();
-			this->draw_order.push_back(this->widgets.size() - 1);
+			auto copy = this->widgets[source].clone();
+			copy.id = this->next_id++;
+			copy.changes = widget_changes::created;
+			copy.set_position(hitbox.position);
+			copy.update_background();
+			auto index = this->insert(std::move(copy));
+			this->queue_update(index);
+			this->update_caches(index);
+			this->history.push_create(this->handles.get_handle(index));
 		}
 	}
 
 	void update_input(const qsf::event_info& event) {
-		if (!this->any_text_field_focus) {
+		if (!this->any_text_field_focus && !this->keyboard_captured) {
 			if (event.key_holding(sf::Keyboard::LControl)) {
 
 				if (this->turbo && event.key_holding(sf::Keyboard::V)) {
 					this->paste(event.mouse_position());
 				}
 				if (event.key_single_pressed(sf::Keyboard::C)) {
-					this->copy_index = this->selected_index;
+					this->copied = this->selected;
 				}
 				if (event.key_pressed(sf::Keyboard::V)) {
 					this->paste(event.mouse_position());
 				}
 				if (event.key_pressed(sf::Keyboard::D)) {
-					if (this->selected_index != qpl::size_max) {
-						auto before = this->copy_index;
-						this->copy_index = this->selected_index;
-						this->paste(this->widgets[this->selected_index].get_hitbox().get_center());
-						this->copy_index = before;
+					auto selected = this->index_of(this->selected);
+					if (selected != qpl::size_max) {
+						auto before = this->copied;
+						this->copied = this->selected;
+						this->paste(this->widgets[selected].get_hitbox().get_center());
+						this->copied = before;
 					}
 				}
 				if (event.key_single_pressed(sf::Keyboard::T)) {
 					this->turbo = !this->turbo;
 				}
+				if (event.key_single_pressed(sf::Keyboard::Enter)) {
+					this->run_scripts(!event.key_holding(sf::Keyboard::LShift));
+				}
+				if (event.key_pressed(sf::Keyboard::Z)) {
+					if (event.key_holding(sf::Keyboard::LShift)) {
+						this->redo();
+					}
+					else {
+						this->undo();
+					}
+				}
+				if (event.key_pressed(sf::Keyboard::Y)) {
+					this->redo();
+				}
 			}
 
 			bool del = event.key_single_pressed(sf::Keyboard::Backspace) || event.key_single_pressed(sf::Keyboard::Delete);
 			if (del) {
-				if (this->selected_index != qpl::size_max) {
-					this->draw_order.erase(std::ranges::find(this->draw_order, this->selected_index));
-					if (this->selected_index != this->widgets.size() - 1) {
-						std::swap(this->widgets[this->selected_index], this->widgets.back());
-						for (auto& i : this->draw_order) {
-							if (i >= this->selected_index) {
-								--i;
-							}
-						}
-					}
-					if (this->widgets.size()) {
-						this->widgets.pop_back();
-					}
-					this->selected_index = qpl::size_max;
+				auto selected = this->index_of(this->selected);
+				if (selected != qpl::size_max) {
+					this->history.push_remove(this->selected, this->get_record(selected));
+					this->remove(selected);
+				}
+			}
+		}
+	}
+
+	void undo() {
+		if (auto entry = this->history.undo()) {
+			this->apply(*entry, false);
+		}
+	}
+	void redo() {
+		if (auto entry = this->history.redo()) {
+			this->apply(*entry, true);
+		}
+	}
+	//plays an entry of the undo history backwards or forwards. entries of widgets that are gone do nothing.
+	//a removed widget's record only lives in the entry while the widget is absent
+	void apply(undo_entry& entry, bool forward) {
+		auto index = this->index_of(entry.handle);
+		switch (entry.type) {
+		case undo_type::move:
+			if (index != qpl::size_max) {
+				this->widgets[index].move(forward ? entry.delta : entry.delta * -1.f);
+				this->update_caches(index);
+				this->queue_update(index);
+			}
+			break;
+		case undo_type::text:
+			if (index != qpl::size_max) {
+				this->materialize(index);
+				this->widgets[index].restore_text(forward ? entry.after : entry.before);
+				this->update_caches(index);
+				auto change = entry.change;
+				if (!forward) {
+					std::swap(change.removed, change.inserted);
 				}
+				this->index_text(index, &change);
+				this->queue_update(index);
+			}
+			break;
+		case undo_type::create:
+		case undo_type::remove:
+			if ((entry.type == undo_type::create) == forward) {
+				if (entry.record) {
+					this->restore(entry);
+				}
+			}
+			else if (index != qpl::size_max) {
+				entry.record = this->get_record(index);
+				this->remove(index);
+				this->history.update_bytes(entry);
+			}
+			break;
+		}
+	}
+	//brings a removed widget back from its record, it comes back on top with a new id and handle
+	void restore(undo_entry& entry) {
+		widget widget;
+		widget.apply(entry.record);
+		widget.id = this->next_id++;
+		widget.changes = widget_changes::created;
+		widget.update_background();
+		auto index = this->insert(std::move(widget));
+		this->queue_update(index);
+		this->update_caches(index);
+		this->history.remap(entry.handle, this->handles.get_handle(index));
+		entry.record.reset();
+		this->history.update_bytes(entry);
+	}
+
+	//unmaterialized widgets are indexed from the archive without keeping the decoded record around.
+	//after an edit only the changed lines are re-indexed
+	void index_text(qpl::size index, const text_rope::line_change* change = nullptr) {
+		auto& widget = this->widgets[index];
+		auto slot = this->handles.get_handle(index).slot;
+		if (widget.is_materialized() && change) {
+			this->search.update(slot, widget.lines, *change);
+		}
+		else if (widget.is_materialized()) {
+			this->search.set(slot, widget.lines);
+		}
+		else {
+			auto record = widget.record ? widget.record : this->archive.decode(widget.archive_index);
+			this->search.set(slot, record->text);
+		}
+	}
+	void index_pending(qpl::size budget) {
+		while (budget && !this->pending_search.empty()) {
+			auto index = this->index_of(this->pending_search.back());
+			this->pending_search.pop_back();
+			if (index != qpl::size_max) {
+				this->index_text(index);
+				--budget;
+			}
+		}
+	}
+	//indexes at most one frame's budget, right after loading the results can be incomplete until indexing caught up
+	search_results find(std::wstring_view query) {
+		this->index_pending(config::search_index_per_frame);
+		auto result = this->search.search(query);
+		result.incomplete = !this->pending_search.empty();
+		return result;
+	}
+	widget_handle get_slot_handle(qpl::u32 slot) const {
+		if (slot >= this->handles.generations.size()) {
+			return {};
+		}
+		return widget_handle{ slot, this->handles.generations[slot] };
+	}
+	void select(widget_handle handle) {
+		auto index = this->index_of(handle);
+		if (index == qpl::size_max) {
+			return;
+		}
+		this->selected = handle;
+		this->raise(index);
+		this->queue_update(index);
+	}
+
+	//scripts run as one pipeline in reading order, top to bottom then left to right
+	void run_scripts(bool selected_only) {
+		std::erase_if(this->pipelines, [](const std::shared_ptr<script_pipeline>& pipeline) {
+			return pipeline->is_finished();
+		});
+
+		std::vector<qpl::size> indices;
+		if (selected_only) {
+			auto selected = this->index_of(this->selected);
+			if (selected != qpl::size_max) {
+				indices.push_back(selected);
+			}
+		}
+		else {
+			for (qpl::size i = 0u; i < this->widgets.size(); ++i) {
+				indices.push_back(i);
 			}
 		}
+		std::erase_if(indices, [&](qpl::size index) {
+			if (this->get_record(index)->type != widget_type::executable_script) {
+				return true;
+			}
+			this->materialize(index);
+			return !this->widgets[index].executable_script || this->widgets[index].executable_script->is_job_active();
+		});
+		if (indices.empty()) {
+			return;
+		}
+		std::ranges::sort(indices, [&](qpl::size a, qpl::size b) {
+			auto a_position = this->get_bounds(a).position;
+			auto b_position = this->get_bounds(b).position;
+			return std::tie(a_position.y, a_position.x) < std::tie(b_position.y, b_position.x);
+		});
+
+		std::vector<std::shared_ptr<const compiled_script>> scripts;
+		for (auto& index : indices) {
+			auto& script = *this->widgets[index].executable_script;
+			if (!script.compiled) {
+				script.compile(this->widgets[index].lines);
+			}
+			scripts.push_back(script.compiled);
+		}
+		auto pipeline = run_pipeline(scripts);
+		for (qpl::size i = 0u; i < indices.size(); ++i) {
+			auto& script = *this->widgets[indices[i]].executable_script;
+			script.job = pipeline->jobs[i];
+			script.update_job();
+			this->queue_update(indices[i]);
+		}
+		this->pipelines.push_back(std::move(pipeline));
+	}
+
+	void remove(qpl::size index) {
+		auto last = this->widgets.size() - 1;
+		if (!(this->widgets[index].changes & widget_changes::created)) {
+			this->deleted_ids.push_back(this->widgets[index].id);
+		}
+		this->grid.remove(index);
+		this->batch.remove(this->draw_order.depth(index));
+		if (index != last) {
+			this->grid.move_index(last, index);
+		}
+		this->erase(index);
+		this->grid.resize(this->widgets.size());
 	}
+	void raise(qpl::size index) {
+		auto from = this->draw_order.depth(index);
+		this->draw_order.raise(index);
+		this->batch.move_index(from, this->draw_order.depth(index));
+		this->compact_draw_order();
+		this->widgets[index].changes |= widget_changes::raised;
+	}
+
+	std::vector<qpl::size> collect_updates(const std::vector<qpl::size>& hover_candidates) {
+		auto result = hover_candidates;
+		for (auto& handle : this->pending_updates) {
+			result.push_back(this->index_of(handle));
+		}
+		for (auto handle : { this->selected, this->focused, this->dragging }) {
+			result.push_back(this->index_of(handle));
+		}
+		this->pending_updates.clear();
+
+		std::ranges::sort(result);
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+		std::erase_if(result, [&](qpl::size index) {
+			return index >= this->widgets.size() || !this->widgets[index].is_materialized();
+		});
+
+		std::ranges::sort(result, [&](qpl::size a, qpl::size b) {
+			return this->draw_order.depth(a) > this->draw_order.depth(b);
+		});
+		return result;
+	}
+
 	void update(const qsf::event_info& event) {
+		profile_scope scope(profile_section::widgets_update);
 		bool other_selected = false;
-		this->any_text_field_focus = false;
 		qpl::size just_selected_index = qpl::size_max;
 
-		for (auto it = this->draw_order.crbegin(); it != this->draw_order.crend(); ++it) {
-			auto index = *it;
+		std::vector<qpl::size> hover_candidates;
+		{
+			profile_scope hit_test_scope(profile_section::hit_test);
+			this->grid.for_each_at(event.mouse_position(), [&](qpl::size index) {
+				hover_candidates.push_back(index);
+			});
+		}
+
+		auto updates = this->collect_updates(hover_candidates);
 
-			event.update(this->widgets[index], other_selected);
-			if (this->widgets[index].just_selected) {
-				this->selected_index = index;
+		this->focused = {};
+		this->dragging = {};
+		bool one_hovering = false;
+
+		for (auto& index : updates) {
+			auto& widget = this->widgets[index];
+
+			bool hover_candidate = std::ranges::find(hover_candidates, index) != hover_candidates.cend();
+			bool hovering = hover_candidate && this->drag_hitboxes[index].contains(event.mouse_position());
+			//copying the rope is O(1), the history only keeps it if the text changed
+			auto lines = widget.lines;
+			auto position = widget.view.position;
+			bool was_dragging = widget.dragging;
+			bool first_update = widget.first_update;
+			event.update(widget, other_selected, hovering);
+			this->update_caches(index);
+			if (widget.just_edited) {
+				auto& change = widget.edited_lines;
+				this->index_text(index, &change);
+				if (!first_update && (change.removed || change.inserted)) {
+					this->history.push_text(this->handles.get_handle(index), lines, widget.lines, change);
+				}
+			}
+			if (widget.dragging && !was_dragging) {
+				this->drag_origin = position;
+			}
+			if (was_dragging && !widget.dragging && widget.view.position != this->drag_origin) {
+				this->history.push_move(this->handles.get_handle(index), widget.view.position - this->drag_origin);
+			}
+			if (widget.just_selected) {
+				this->selected = this->handles.get_handle(index);
 				just_selected_index = index;
 				other_selected = true;
 			}
-			if (this->widgets[index].text.has_focus()) {
-				any_text_field_focus = true;
+			if (widget.is_editing()) {
+				this->focused = this->handles.get_handle(index);
+			}
+			if (widget.dragging) {
+				this->dragging = this->handles.get_handle(index);
+			}
+			if (widget.hovering) {
+				one_hovering = true;
+			}
+
+			//hovered widgets need one more update to notice the mouse leaving
+			if (hover_candidate || widget.is_animating()) {
+				this->queue_update(index);
 			}
 		}
 		if (just_selected_index != qpl::size_max) {
-			this->draw_order.erase(std::ranges::find(this->draw_order, just_selected_index));
-			this->draw_order.push_back(just_selected_index);
+			this->raise(just_selected_index);
 		}
+		this->any_text_field_focus = this->index_of(this->focused) != qpl::size_max;
 
 		this->update_input(event);
+		this->index_pending(config::search_index_per_frame);
 
-		bool one_hovering = false;
-		this->allow_view_drag = true;
-		for (auto& i : this->widgets) {
-			if (i.text.has_focus() || i.dragging) {
-				this->allow_view_drag = false;
-			}
-			if (i.hovering) {
-				one_hovering = true;
-			}
-		}
+		this->allow_view_drag = this->index_of(this->focused) == qpl::size_max && this->index_of(this->dragging) == qpl::size_max;
 
 		if (one_hovering) {
 			qpl::winsys::set_cursor_hand();
@@ -213,11 +733,128 @@ struct widgets {
 		else {
 			qpl::winsys::set_cursor_normal();
 		}
+		this->batch.upload();
+	}
+
+	void set_visible_hitbox(qpl::hitbox hitbox, qpl::f32 world_units_per_pixel) {
+		this->visible_hitbox = hitbox;
+		this->world_units_per_pixel = world_units_per_pixel;
+		this->culling = true;
+		this->stream_widgets();
+	}
+	bool is_level_of_detail() const {
+		auto text_pixel_size = config::widget_text_character_size / this->world_units_per_pixel;
+		return text_pixel_size < config::widget_lod_text_pixel_size;
+	}
+
+	void add_lod_rectangle(qpl::hitbox hitbox, qpl::rgb color) const {
+		auto index = this->lod_rectangles.size();
+		this->lod_rectangles.resize(index + 6u);
+
+		std::array<qpl::vec2, 4u> corners = {
+			hitbox.position,
+			hitbox.position + qpl::vec(hitbox.dimension.x, 0),
+			hitbox.position + hitbox.dimension,
+			hitbox.position + qpl::vec(0, hitbox.dimension.y)
+		};
+		constexpr std::array<qpl::size, 6u> triangles = { 0, 1, 2, 0, 2, 3 };
+		for (qpl::size i = 0u; i < triangles.size(); ++i) {
+			this->lod_rectangles[index + i].position = corners[triangles[i]];
+			this->lod_rectangles[index + i].color = color;
+		}
+	}
+
+	void mark_visible() const {
+		this->visible_marks.resize(this->widgets.size());
+		++this->visible_mark;
+		if (this->visible_mark == 0u) {
+			std::fill(this->visible_marks.begin(), this->visible_marks.end(), 0u);
+			this->visible_mark = 1u;
+		}
+		if (!this->culling) {
+			std::fill(this->visible_marks.begin(), this->visible_marks.end(), this->visible_mark);
+			return;
+		}
+		//script chrome sticks out of the widget hitbox, so the query is padded
+		this->grid.for_each_in(this->visible_hitbox.increased(config::widget_cull_margin), [&](qpl::size index) {
+			if (index < this->visible_marks.size()) {
+				this->visible_marks[index] = this->visible_mark;
+			}
+		});
+	}
+	bool is_visible(qpl::size index) const {
+		return this->visible_marks[index] == this->visible_mark;
+	}
+
+	void next_group() const {
+		this->group_widgets.clear();
+		this->group_positions.clear();
+		++this->group_mark;
+		if (this->group_mark == 0u) {
+			std::fill(this->group_marks.begin(), this->group_marks.end(), 0u);
+			this->group_mark = 1u;
+		}
+	}
+	void draw_group(qsf::draw_object& draw) const {
+		this->batch.draw(draw, this->group_positions);
+		for (auto& i : this->group_widgets) {
+			auto& widget = this->widgets[i];
+			if (auto texture = this->texture_cache.get(this->handles.get_handle(i), widget, this->world_units_per_pixel)) {
+				draw.draw(cached_text_pass(widget, *texture));
+			}
+			else {
+				draw.draw(widget_text_pass(widget));
+			}
+		}
+		this->next_group();
 	}
 
 	void draw(qsf::draw_object& draw) const {
-		for (auto& i : this->draw_order) {
-			draw.draw(this->widgets[i]);
+		profile_scope scope(profile_section::draw);
+		auto& profiler = get_profiler();
+		this->mark_visible();
+
+		qpl::size drawn = 0u;
+		if (this->culling && this->is_level_of_detail()) {
+			this->lod_rectangles.set_primitive_type(sf::PrimitiveType::Triangles);
+			this->lod_rectangles.clear();
+			this->draw_order.for_each([&](qpl::size i) {
+				if (this->is_visible(i)) {
+					this->add_lod_rectangle(this->grid.hitboxes[i], this->widgets[i].color);
+					++drawn;
+				}
+			});
+			draw.draw(this->lod_rectangles);
+			profiler.count(profile_counter::draw_calls);
+			profiler.count(profile_counter::widgets_drawn, drawn);
+			profiler.count(profile_counter::widgets_culled, this->widgets.size() - drawn);
+			return;
 		}
+
+		//back to front in groups of widgets that don't overlap each other. the order within a group can't be seen,
+		//so a group draws all its chrome and backgrounds in runs of consecutive batch slots, then its texts on top.
+		//a widget that overlaps one of the current group starts the next group, so overlapping widgets keep their order
+		this->texture_cache.next_frame();
+		this->group_marks.resize(this->widgets.size());
+		this->next_group();
+		this->draw_order.for_each([&](qpl::size i) {
+			if (!this->is_visible(i) || !this->widgets[i].is_materialized()) {
+				return;
+			}
+			bool overlaps = false;
+			this->grid.for_each_in(this->grid.hitboxes[i], [&](qpl::size other) {
+				overlaps = overlaps || this->group_marks[other] == this->group_mark;
+			});
+			if (overlaps) {
+				this->draw_group(draw);
+			}
+			this->group_marks[i] = this->group_mark;
+			this->group_widgets.push_back(i);
+			this->group_positions.push_back(this->draw_order.depth(i));
+			++drawn;
+		});
+		this->draw_group(draw);
+		profiler.count(profile_counter::widgets_drawn, drawn);
+		profiler.count(profile_counter::widgets_culled, this->widgets.size() - drawn);
 	}
 };
\ No newline at end of file
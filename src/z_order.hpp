@@ -0,0 +1,128 @@
+#pragma once
+#include <qpl/qpl.hpp>
+
+//back to front order of widget indices in a contiguous vector.
+//raising or removing leaves a tombstone behind, so both are O(1); the owner compacts the slots with
+//compact_if_sparse once tombstones outnumber live entries. the slot position doubles as depth: higher is further in front
+struct z_order {
+	constexpr static qpl::size tombstone = qpl::size_max;
+
+	std::vector<qpl::size> slots;
+	std::vector<qpl::size> positions;
+	qpl::size count = 0u;
+
+	void clear() {
+		this->slots.clear();
+		this->positions.clear();
+		this->count = 0u;
+	}
+	void assign(const std::vector<qpl::size>& order, qpl::size size) {
+		this->clear();
+		this->positions.assign(size, tombstone);
+		for (auto& i : order) {
+			if (i < size && this->positions[i] == tombstone) {
+				this->push_back(i);
+			}
+		}
+		//indices missing from a damaged order still have to be drawn
+		for (qpl::size i = 0u; i < size; ++i) {
+			if (this->positions[i] == tombstone) {
+				this->push_back(i);
+			}
+		}
+	}
+	void push_back(qpl::size index) {
+		if (index >= this->positions.size()) {
+			this->positions.resize(index + 1, tombstone);
+		}
+		this->positions[index] = this->slots.size();
+		this->slots.push_back(index);
+		++this->count;
+	}
+	void raise(qpl::size index) {
+		auto& position = this->positions[index];
+		if (position == this->slots.size() - 1) {
+			return;
+		}
+		this->slots[position] = tombstone;
+		position = this->slots.size();
+		this->slots.push_back(index);
+	}
+	void remove(qpl::size index) {
+		this->slots[this->positions[index]] = tombstone;
+		this->positions[index] = tombstone;
+		--this->count;
+	}
+	//index from took over index to, e.g. after a swap-and-pop
+	void move_index(qpl::size from, qpl::size to) {
+		this->positions[to] = this->positions[from];
+		this->positions[from] = tombstone;
+		if (this->positions[to] != tombstone) {
+			this->slots[this->positions[to]] = to;
+		}
+	}
+	void resize(qpl::size size) {
+		this->positions.resize(size, tombstone);
+	}
+
+	//moved(from, to) is called for every entry whose position changed, in ascending order
+	template<typename F>
+	void compact_if_sparse(F&& moved) {
+		if (this->slots.size() > this->count * 2 + 64u) {
+			this->compact(moved);
+		}
+	}
+	void compact_if_sparse() {
+		this->compact_if_sparse([](qpl::size, qpl::size) {});
+	}
+	template<typename F>
+	void compact(F&& moved) {
+		qpl::size position = 0u;
+		for (qpl::size from = 0u; from < this->slots.size(); ++from) {
+			auto i = this->slots[from];
+			if (i != tombstone) {
+				this->positions[i] = position;
+				this->slots[position] = i;
+				if (from != position) {
+					moved(from, position);
+				}
+				++position;
+			}
+		}
+		this->slots.resize(position);
+	}
+
+	bool empty() const {
+		return this->count == 0u;
+	}
+	qpl::size size() const {
+		return this->count;
+	}
+	qpl::size depth(qpl::size index) const {
+		return this->positions[index];
+	}
+	qpl::size back() const {
+		for (auto it = this->slots.crbegin(); it != this->slots.crend(); ++it) {
+			if (*it != tombstone) {
+				return *it;
+			}
+		}
+		return tombstone;
+	}
+	template<typename F>
+	void for_each(F&& function) const {
+		for (auto& i : this->slots) {
+			if (i != tombstone) {
+				function(i);
+			}
+		}
+	}
+	std::vector<qpl::size> to_vector() const {
+		std::vector<qpl::size> result;
+		result.reserve(this->count);
+		this->for_each([&](qpl::size index) {
+			result.push_back(index);
+		});
+		return result;
+	}
+};
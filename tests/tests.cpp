@@ -0,0 +1,175 @@
+#include <qpl/qpl.hpp>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include "../src/script.hpp"
+
+//regression tests for behavior that broke before and can be checked without a window.
+//usage: tests [name filter], returns the number of failed tests
+//
+//building: like benchmark/benchmark.cpp this file is its own executable with its own main, it must not be compiled into the app.
+//compile it alone with the same c++20 settings, include paths (qpl, sfml) and libraries as src/main.cpp, e.g.
+//	g++ -std=c++20 -O2 tests/tests.cpp -o widgets_tests -lqpl -lsfml-graphics -lsfml-window -lsfml-system
+//tests that need files work in a fresh directory below the system temp directory
+
+struct test_failure {
+	std::string message;
+};
+//the environment can't produce the tested condition, e.g. permissions while running as root
+struct test_skipped {
+	std::string reason;
+};
+
+#define test_check(condition) \
+	if (!(condition)) { \
+		throw test_failure{ qpl::to_string(__FILE__, ":", __LINE__, ": ", #condition) }; \
+	}
+
+struct test_case {
+	std::string name;
+	std::function<void()> function;
+};
+
+inline std::vector<test_case>& get_tests() {
+	static std::vector<test_case> tests;
+	return tests;
+}
+struct test_registration {
+	test_registration(std::string name, std::function<void()> function) {
+		get_tests().push_back({ std::move(name), std::move(function) });
+	}
+};
+
+//a fresh directory for one test, removed again when the test is done
+struct test_directory {
+	std::filesystem::path path;
+
+	test_directory(const std::string& name) {
+		this->path = std::filesystem::temp_directory_path() / "widgets_tests" / name;
+		std::filesystem::remove_all(this->path);
+		std::filesystem::create_directories(this->path);
+	}
+	~test_directory() {
+		std::error_code error;
+		std::filesystem::remove_all(this->path, error);
+	}
+};
+
+static compiled_script compile_text(std::wstring_view text) {
+	text_rope rope;
+	rope.assign(text);
+	script_compiler compiler;
+	return compiler.compile(rope);
+}
+
+static test_registration script_lines_count_blank_lines("script lines count blank lines", [] {
+	auto script = compile_text(L"copy a b\n\n\ncopy a\n\nmove a b");
+	test_check(script.line_count == 6u);
+	test_check(script.errors.size() == 1u);
+	test_check(script.errors[0].line == 3u);
+	test_check(script.errors[0].string().starts_with("line 4:"));
+	test_check(script.instructions.size() == 2u);
+	test_check(script.instructions[0].line == 0u);
+	test_check(script.instructions[1].line == 5u);
+});
+
+static void write_file(const std::filesystem::path& path, const std::string& content) {
+	std::ofstream file(path, std::ios::binary);
+	file << content;
+}
+static std::string read_file(const std::filesystem::path& path) {
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), {});
+}
+
+static test_registration copy_read_only_file_in_chunks("copy read-only file in chunks", [] {
+	test_directory directory("copy_read_only");
+	std::string content;
+	for (qpl::size i = 0u; content.size() < 256u * 1024u; ++i) {
+		content += qpl::to_string(i, ' ');
+	}
+	auto source = directory.path / "source.bin";
+	auto destination = directory.path / "destination.bin";
+	write_file(source, content);
+	auto read_only = std::filesystem::perms::owner_read | std::filesystem::perms::group_read | std::filesystem::perms::others_read;
+	std::filesystem::permissions(source, read_only);
+
+	copy_engine engine;
+	engine.chunk_size = 16u * 1024u;
+	engine.thread_count = 4u;
+	test_check(engine.copy(source, destination));
+	test_check(engine.errors.empty());
+	test_check(read_file(destination) == content);
+	test_check((std::filesystem::status(destination).permissions() & std::filesystem::perms::all) == read_only);
+});
+
+static test_registration sync_keeps_files_of_unreadable_directory("sync keeps files of an unreadable directory", [] {
+	test_directory directory("sync_unreadable");
+	auto a = directory.path / "a";
+	auto b = directory.path / "b";
+	std::filesystem::create_directories(a / "locked");
+	std::filesystem::create_directories(b);
+	write_file(a / "top.txt", "top");
+	write_file(a / "locked" / "inner.txt", "inner");
+	auto manifest = sync_manifest::get_path(a, b);
+	struct manifest_cleanup {
+		std::filesystem::path path;
+		~manifest_cleanup() {
+			std::error_code error;
+			std::filesystem::remove(this->path, error);
+		}
+	} cleanup{ manifest };
+
+	synchronizer first;
+	first.a = a;
+	first.b = b;
+	test_check(first.run());
+	test_check(std::filesystem::exists(b / "locked" / "inner.txt"));
+
+	std::filesystem::permissions(a / "locked", std::filesystem::perms::none);
+	std::error_code error;
+	std::filesystem::directory_iterator probe(a / "locked", error);
+	if (!error) {
+		std::filesystem::permissions(a / "locked", std::filesystem::perms::owner_all);
+		throw test_skipped{ "unreadable directories can still be read, e.g. as root" };
+	}
+	synchronizer second;
+	second.a = a;
+	second.b = b;
+	bool result = second.run();
+	std::filesystem::permissions(a / "locked", std::filesystem::perms::owner_all);
+	test_check(!result);
+	test_check(second.operations.empty());
+	test_check(std::filesystem::exists(b / "locked" / "inner.txt"));
+	test_check(std::filesystem::exists(a / "locked" / "inner.txt"));
+});
+
+int main(int argc, char** argv) {
+	std::string filter = argc > 1 ? argv[1] : "";
+	qpl::size failed = 0u;
+	qpl::size run = 0u;
+	for (auto& test : get_tests()) {
+		if (!filter.empty() && test.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		++run;
+		try {
+			test.function();
+			std::cout << "passed: " << test.name << '\n';
+		}
+		catch (const test_skipped& skipped) {
+			std::cout << "skipped: " << test.name << " - " << skipped.reason << '\n';
+		}
+		catch (const test_failure& failure) {
+			std::cout << "FAILED: " << test.name << " - " << failure.message << '\n';
+			++failed;
+		}
+		catch (const std::exception& exception) {
+			std::cout << "FAILED: " << test.name << " - exception: " << exception.what() << '\n';
+			++failed;
+		}
+	}
+	std::cout << run - failed << " of " << run << " tests passed\n";
+	return static_cast<int>(failed);
+}